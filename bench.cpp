@@ -0,0 +1,453 @@
+#include "json.h"
+#include "json_bind.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define BENCH(name, n, body)                                                                   \
+    do                                                                                         \
+    {                                                                                          \
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();        \
+        body;                                                                                  \
+        double ms = std::chrono::duration<double, std::milli>(                                 \
+            std::chrono::steady_clock::now() - start).count();                                 \
+        printf("%-40s %10zu elements %10.3f ms %8.2f ns/element\n", name, (size_t)(n), ms,     \
+               ms * 1e6 / (double)(n));                                                        \
+    } while (0)
+
+/**
+ * 没有容量字段时只能每次追加都重新分配整块并拷贝
+*/
+void append_exact_size(json_value* v, double n)
+{
+    json_value* e = (json_value*)malloc((v->a.size + 1) * sizeof(json_value));
+    if (v->a.size > 0) {
+        memcpy(e, v->a.e, v->a.size * sizeof(json_value));
+    }
+    free(v->a.e);
+    v->a.e = e;
+    v->a.capacity = ++v->a.size;
+    json_init(&e[v->a.size - 1]);
+    set_number(&e[v->a.size - 1], n);
+}
+
+/**
+ * 同一字符串重复 n 次组成数组，分别在校验和不校验UTF-8时解析
+*/
+void bench_utf8_corpus(const char* name, const char* s, size_t n)
+{
+    std::string json = "[";
+    char title[64];
+    int ret = PARSE_OK;
+    for (size_t i = 0; i < n; i++) {
+        json += i ? ",\"" : "\"";
+        json += s;
+        json += "\"";
+    }
+    json += "]";
+
+    snprintf(title, sizeof(title), "utf8 %s validated", name);
+    BENCH(title, json.size(), {
+        json_value v;
+        json_init(&v);
+        ret |= parse(&v, json.c_str());
+        json_free(&v);
+    });
+    snprintf(title, sizeof(title), "utf8 %s unchecked", name);
+    BENCH(title, json.size(), {
+        json_value v;
+        json_init(&v);
+        ret |= parse_with_flags(&v, json.c_str(), PARSE_FLAG_NO_UTF8_VALIDATION);
+        json_free(&v);
+    });
+    if (ret != PARSE_OK) {
+        printf("bench_utf8: unexpected result %d\n", ret);
+    }
+}
+
+/* 元素按输入字节计 */
+void bench_utf8(size_t n)
+{
+    bench_utf8_corpus("ascii", "The quick brown fox jumps over the lazy dog, again and again.", n);
+    bench_utf8_corpus("latin", "Größenmaßstäbe für Übergänge: café, naïve, façade, señor, smørrebrød.", n);
+    bench_utf8_corpus("cjk", "\xE6\x95\xB0\xE6\x8D\xAE\xE6\xA0\xBC\xE5\xBC\x8F\xE8\xA7\xA3\xE6\x9E\x90\xE5\x99\xA8"
+                             "\xE7\x9A\x84\xE6\x80\xA7\xE8\x83\xBD\xE6\xB5\x8B\xE8\xAF\x95\xE6\x96\x87\xE6\x9C\xAC"
+                             "\xE5\x8C\x85\xE5\x90\xAB\xE5\xA4\xA7\xE9\x87\x8F\xE4\xB8\xAD\xE6\x96\x87\xE5\xAD\x97"
+                             "\xE7\xAC\xA6", n);
+    bench_utf8_corpus("emoji", "\xF0\x9F\x98\x80\xF0\x9F\x9A\x80\xF0\x9F\x8E\x89\xF0\x9F\x91\x8D\xF0\x9F\x94\xA5"
+                               "\xF0\x9F\x92\xAF\xF0\x9F\x8C\x8D\xF0\x9F\x8D\x95\xF0\x9F\x8E\xB5\xF0\x9F\x93\xA6"
+                               "\xF0\x9F\x98\x80\xF0\x9F\x9A\x80\xF0\x9F\x8E\x89\xF0\x9F\x91\x8D\xF0\x9F\x94\xA5", n);
+    bench_utf8_corpus("short cjk", "\xE4\xB8\xAD\xE6\x96\x87", n * 4);
+}
+
+void bench_array_build(size_t n)
+{
+    json_value v;
+    json_init(&v);
+
+    BENCH("array pushback", n, {
+        set_array(&v, 0);
+        for (size_t i = 0; i < n; i++)
+            set_number(pushback_array_element(&v), (double)i);
+    });
+
+    BENCH("array reserve + pushback", n, {
+        set_array(&v, n);
+        for (size_t i = 0; i < n; i++)
+            set_number(pushback_array_element(&v), (double)i);
+    });
+
+    BENCH("array insert at front", n / 100, {
+        set_array(&v, 0);
+        for (size_t i = 0; i < n / 100; i++)
+            set_number(insert_array_element(&v, 0), (double)i);
+    });
+
+    BENCH("array exact-size realloc (old way)", n / 100, {
+        set_array(&v, 0);
+        for (size_t i = 0; i < n / 100; i++)
+            append_exact_size(&v, (double)i);
+    });
+
+    BENCH("array of strings pushback", n, {
+        set_array(&v, 0);
+        for (size_t i = 0; i < n; i++)
+            set_string(pushback_array_element(&v), "Hello World", 11);
+    });
+
+    BENCH("array popback", n, {
+        while (get_array_size(&v) > 0)
+            popback_array_element(&v);
+    });
+
+    json_free(&v);
+}
+
+void bench_object_build(size_t n)
+{
+    json_value v;
+    char key[16];
+    json_init(&v);
+
+    BENCH("object pushback_object_member", n, {
+        set_object(&v, 0);
+        for (size_t i = 0; i < n; i++) {
+            int klen = snprintf(key, sizeof(key), "k%zu", i);
+            set_number(pushback_object_member(&v, key, klen), (double)i);
+        }
+    });
+
+    BENCH("object reserve + pushback_object_member", n, {
+        set_object(&v, n);
+        for (size_t i = 0; i < n; i++) {
+            int klen = snprintf(key, sizeof(key), "k%zu", i);
+            set_number(pushback_object_member(&v, key, klen), (double)i);
+        }
+    });
+
+    /* 每次追加前线性查重，整体 O(n^2)，只跑小规模 */
+    BENCH("object set_object_value (find or insert)", n / 500, {
+        set_object(&v, 0);
+        for (size_t i = 0; i < n / 500; i++) {
+            int klen = snprintf(key, sizeof(key), "k%zu", i);
+            set_number(set_object_value(&v, key, klen), (double)i);
+        }
+    });
+
+    json_free(&v);
+}
+
+struct bench_record {
+    int id;
+    std::string name;
+    double score;
+    std::vector<int> tags;
+};
+
+JSON_BIND_BEGIN(bench_record)
+    JSON_BIND_FIELD(id)
+    JSON_BIND_FIELD(name)
+    JSON_BIND_FIELD(score)
+    JSON_BIND_FIELD(tags)
+JSON_BIND_END()
+
+std::string make_records(size_t n)
+{
+    std::string json = "[";
+    char buf[256];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf),
+            "%s{\"id\":%zu,\"name\":\"user-%zu\",\"score\":%zu.25,\"tags\":[1,2,3,4],"
+            "\"meta\":{\"created\":\"2024-01-01T00:00:00Z\",\"flags\":[true,false,null]}}",
+            i ? "," : "", i, i, i % 100);
+        json += buf;
+    }
+    json += "]";
+    return json;
+}
+
+/**
+ * 先建树再逐个字段拷贝到结构体
+*/
+int records_from_tree(std::vector<bench_record>& out, const char* json)
+{
+    json_value v;
+    int ret;
+    json_init(&v);
+    if ((ret = parse(&v, json)) != PARSE_OK) {
+        return ret;
+    }
+    out.clear();
+    out.resize(get_array_size(&v));
+    for (size_t i = 0; i < get_array_size(&v); i++) {
+        json_value* e = get_array_element(&v, i);
+        bench_record& r = out[i];
+        json_value* f;
+        if ((f = find_object_value(e, "id", 2)) != NULL) r.id = (int)get_number(f);
+        if ((f = find_object_value(e, "name", 4)) != NULL) r.name.assign(get_string(f), get_string_length(f));
+        if ((f = find_object_value(e, "score", 5)) != NULL) r.score = get_number(f);
+        if ((f = find_object_value(e, "tags", 4)) != NULL) {
+            r.tags.resize(get_array_size(f));
+            for (size_t j = 0; j < get_array_size(f); j++)
+                r.tags[j] = (int)get_number(get_array_element(f, j));
+        }
+    }
+    json_free(&v);
+    return PARSE_OK;
+}
+
+void bench_bind(size_t n)
+{
+    std::string json = make_records(n);
+    std::vector<bench_record> records;
+    int ret = PARSE_OK;
+
+    BENCH("records parse tree + copy", n, {
+        ret |= records_from_tree(records, json.c_str());
+    });
+
+    BENCH("records json::decode", n, {
+        ret |= json::decode(records, json.c_str());
+    });
+
+    if (ret != PARSE_OK || records.size() != n) {
+        printf("bench_bind: unexpected result %d\n", ret);
+    }
+}
+
+void bench_equal_hash(size_t n)
+{
+    std::string json = make_records(n);
+    json_value v1, v2;
+    size_t h = 0;
+    int equal = 0;
+    json_init(&v1);
+    json_init(&v2);
+    parse(&v1, json.c_str());
+    json_copy(&v2, &v1);
+
+    BENCH("json_equal large tree (identical)", n, {
+        equal = json_equal(&v1, &v2);
+    });
+
+    /* 交换每个对象的前两个成员，走按键查找的路径 */
+    for (size_t i = 0; i < n; i++) {
+        json_value* e = get_array_element(&v2, i);
+        json_member tmp = e->o.m[0];
+        e->o.m[0] = e->o.m[1];
+        e->o.m[1] = tmp;
+    }
+
+    BENCH("json_equal large tree (reordered)", n, {
+        equal &= json_equal(&v1, &v2);
+    });
+
+    BENCH("json_hash large tree", n, {
+        h ^= json_hash(&v1);
+    });
+
+    if (!equal || json_hash(&v1) != json_hash(&v2)) {
+        printf("bench_equal_hash: unexpected result %zu\n", h);
+    }
+    json_free(&v1);
+    json_free(&v2);
+
+    /* 一个大对象，另一份成员完全打乱，整个对象都走乱序路径 */
+    char key[16];
+    set_object(&v1, n);
+    set_object(&v2, n);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    srand(1);
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int klen = snprintf(key, sizeof(key), "k%zu", i);
+        set_number(pushback_object_member(&v1, key, klen), (double)i);
+        klen = snprintf(key, sizeof(key), "k%zu", order[i]);
+        set_number(pushback_object_member(&v2, key, klen), (double)order[i]);
+    }
+
+    BENCH("json_equal large object (shuffled)", n, {
+        equal = json_equal(&v1, &v2);
+    });
+
+    BENCH("json_hash large object", n, {
+        h ^= json_hash(&v2);
+    });
+
+    if (!equal) {
+        printf("bench_equal_hash: shuffled objects differ\n");
+    }
+    json_free(&v1);
+    json_free(&v2);
+}
+
+void null_sink(void* user, const char* data, size_t len)
+{
+    (void)data;
+    *(size_t*)user += len;
+}
+
+void bench_reformat(size_t n)
+{
+    std::string json = make_records(n);
+    size_t bytes = 0;
+    int ret = PARSE_OK;
+
+    BENCH("parse + json_free (DOM round trip)", n, {
+        json_value v;
+        json_init(&v);
+        ret |= parse(&v, json.c_str());
+        json_free(&v);
+    });
+
+    BENCH("json_reformat minify", n, {
+        ret |= json_reformat(json.c_str(), 0, null_sink, &bytes);
+    });
+
+    BENCH("json_reformat indent 4", n, {
+        ret |= json_reformat(json.c_str(), 4, null_sink, &bytes);
+    });
+
+    if (ret != PARSE_OK) {
+        printf("bench_reformat: unexpected result %d\n", ret);
+    }
+}
+
+/**
+ * 结构相同、内容不同的一批消息，模拟行情推送
+*/
+void bench_reparse(size_t n)
+{
+    std::vector<std::string> messages;
+    char buf[256];
+    for (size_t i = 0; i < 16; i++) {
+        snprintf(buf, sizeof(buf),
+            "{\"symbol\":\"SYM%zu\",\"bid\":%zu.5,\"ask\":%zu.75,\"levels\":[%zu,%zu,%zu,%zu],"
+            "\"venue\":{\"id\":%zu,\"name\":\"exchange-%zu\"}}",
+            i, i, i, i, i + 1, i + 2, i + 3, i % 4, i % 4);
+        messages.push_back(buf);
+    }
+    json_value v;
+    parse_stats stats;
+    parse_options opt = { PARSE_FLAG_DEFAULT, NULL, &stats };
+    size_t allocs = 0;
+    int ret = PARSE_OK;
+    json_init(&v);
+
+    BENCH("json_free + parse per message", n, {
+        for (size_t i = 0; i < n; i++) {
+            json_free(&v);
+            ret |= parse_with_options(&v, messages[i % 16].c_str(), &opt);
+            allocs += stats.alloc_count;
+        }
+    });
+    printf("  %-38s %10.2f\n", "allocations per message", (double)allocs / n);
+
+    allocs = 0;
+    BENCH("reparse per message", n, {
+        for (size_t i = 0; i < n; i++) {
+            ret |= reparse_with_options(&v, messages[i % 16].c_str(), &opt);
+            allocs += stats.alloc_count;
+        }
+    });
+    printf("  %-38s %10.2f\n", "allocations per message", (double)allocs / n);
+
+    if (ret != PARSE_OK) {
+        printf("bench_reparse: unexpected result %d\n", ret);
+    }
+    json_free(&v);
+}
+
+#ifdef JSON_PROFILE
+/**
+ * 每种语料单独清零计数再解析，分别看时间花在哪个阶段
+*/
+void profile_corpus(const char* title, const std::string& json, size_t rounds)
+{
+    int ret = PARSE_OK;
+    json_profile_reset();
+    for (size_t i = 0; i < rounds; i++) {
+        json_value v;
+        json_init(&v);
+        ret |= parse(&v, json.c_str());
+        json_free(&v);
+    }
+    json_profile_dump(stdout, title);
+    if (ret != PARSE_OK) {
+        printf("profile_corpus: unexpected result %d\n", ret);
+    }
+}
+
+void bench_profile(size_t n)
+{
+    std::string escapes = "[", numbers = "[", pretty;
+    char buf[128];
+    for (size_t i = 0; i < n; i++) {
+        escapes += i ? "," : "";
+        escapes += "\"line\\n\\t\\\"quoted\\\" \\u00e9\\u4e2d \\uD834\\uDD1E end\"";
+        snprintf(buf, sizeof(buf), "%s%zu.%03zue-%zu,-%zu", i ? "," : "", i, i % 1000, i % 20, i * 7919);
+        numbers += buf;
+    }
+    escapes += "]";
+    numbers += "]";
+    char* out;
+    size_t len;
+    if (json_reformat_string(make_records(n).c_str(), 4, &out, &len) == PARSE_OK) {
+        pretty.assign(out, len);
+        free(out);
+    }
+
+    profile_corpus("records", make_records(n), 10);
+    profile_corpus("escape-heavy strings", escapes, 10);
+    profile_corpus("numbers", numbers, 10);
+    profile_corpus("records, pretty-printed", pretty, 10);
+}
+#endif
+
+int main()
+{
+    bench_array_build(1000000);
+    bench_object_build(1000000);
+    bench_bind(200000);
+    bench_equal_hash(200000);
+    bench_reformat(200000);
+    bench_reparse(1000000);
+    bench_utf8(100000);
+#ifdef JSON_PROFILE
+    bench_profile(20000);
+#else
+    printf("configure with -DJSON_PROFILE=ON for a per-phase breakdown of each corpus\n");
+#endif
+    return 0;
+}
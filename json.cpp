@@ -1,4 +1,10 @@
 #include "json.h"
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SSE2 1
+#endif
 
 #define EXPECT(c,ch)   do{ assert(*c->json == (ch)); c->json++; } while (0);
 #define ISDIGIT(ch)   (ch >= '0' && ch<='9')
@@ -12,27 +18,114 @@ int parse_true(context *c, json_value *v);
 int parse_false(context *c, json_value *v);
 int parse_number(context *c, json_value *v);
 int parse_string(context* c, json_value* v);
+int parse_string_raw(context* c, char** str, size_t* len);
+int parse_string_skip(context* c);
 int parse_literal(context *c, json_value *v, const char* literal, json_type type);
 int parse_array(context *c, json_value *v);
+int parse_object(context *c, json_value *v);
 void* context_push(context* c, size_t size);
 void* context_pop(context* c, size_t size);
+void json_free_value(json_value* v, const json_allocator* alloc);
 
 #ifndef PARSE_STACK_INIT_SIZE
 #define PARSE_STACK_INIT_SIZE 256
 #endif
 
+#ifdef JSON_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_CLOCK() ((uint64_t)__rdtsc())
+#else
+#include <chrono>
+#define PROFILE_CLOCK() ((uint64_t)std::chrono::steady_clock::now().time_since_epoch().count())
+#endif
+
+thread_local json_profile profile_data;
+
+/* 离开作用域时把耗时记到对应阶段，函数有多个返回点也不会漏记 */
+struct profile_scope {
+    int phase;
+    uint64_t start;
+    explicit profile_scope(int p) : phase(p), start(PROFILE_CLOCK()) {}
+    ~profile_scope() {
+        profile_data.cycles[phase] += PROFILE_CLOCK() - start;
+        profile_data.calls[phase]++;
+    }
+};
+
+#define PROFILE_COUNT(field, n) (profile_data.field += (n))
+#define PROFILE_SCOPE(phase) profile_scope profile_scope_##phase(phase)
+#else
+#define PROFILE_COUNT(field, n) ((void)0)
+#define PROFILE_SCOPE(phase) ((void)0)
+#endif
+
+void* json_default_malloc(void* user, size_t size)
+{
+    (void)user;
+    return malloc(size);
+}
+
+void* json_default_realloc(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+    (void)user; (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+void json_default_free(void* user, void* ptr, size_t size)
+{
+    (void)user; (void)size;
+    free(ptr);
+}
+
+const json_allocator json_default_allocator = {
+    json_default_malloc, json_default_realloc, json_default_free, NULL
+};
+
+/**
+ * 解析期间的所有分配都经过这里，顺便记录统计
+*/
+void* context_malloc(context* c, size_t size)
+{
+    if (c->stats) {
+        c->stats->alloc_count++;
+        c->stats->alloc_bytes += size;
+    }
+    return c->alloc->malloc_fn(c->alloc->user, size);
+}
+
+void* context_realloc(context* c, void* ptr, size_t old_size, size_t new_size)
+{
+    if (c->stats) {
+        c->stats->alloc_count++;
+        c->stats->alloc_bytes += new_size;
+    }
+    return c->alloc->realloc_fn(c->alloc->user, ptr, old_size, new_size);
+}
+
 void* context_push(context* c, size_t size)
 {
     void* ret;
     assert(size > 0);
     if(c->top + size >= c->size) {
+        PROFILE_SCOPE(PROFILE_STACK_GROW);
+        PROFILE_COUNT(stack_reallocs, 1);
+        size_t old_size = c->size;
         if(c->size == 0) {
             c->size = PARSE_STACK_INIT_SIZE;
         }
         while(c->top + size >= c->size) {
             c->size += c->size >> 1;  /* c-size * 1.5 */
         }
-        c->stack = (char*)realloc(c->stack, c->size);
+        if (c->stack == NULL) {
+            c->stack = (char*)context_malloc(c, c->size);
+        }
+        else {
+            c->stack = (char*)context_realloc(c, c->stack, old_size, c->size);
+        }
+        if (c->stats && c->size > c->stats->peak_stack_size) {
+            c->stats->peak_stack_size = c->size;
+        }
     }
     ret = c->stack + c->top;
     c->top += size;
@@ -57,20 +150,41 @@ double get_number(const json_value *value){
 }
 
 void set_number(json_value *v, double n){
+    set_number_with(v, n, &json_default_allocator);
+}
+
+void set_number_with(json_value *v, double n, const json_allocator* alloc){
     assert(v != NULL);
-    json_free(v);
+    json_free_value(v, alloc);
     v->type = NUMBER;
     v->n = n;
 }
 
+/**
+ * 复制出一个以'\0'结尾的字符串
+*/
+char* string_dup(const json_allocator* alloc, const char* s, size_t len)
+{
+    char* ret = (char *)alloc->malloc_fn(alloc->user, len + 1);
+    if (len > 0) {
+        memcpy(ret, s, len);
+    }
+    ret[len] = '\0';
+    return ret;
+}
+
 void set_string(json_value* v, const char* s, size_t len)
+{
+    set_string_with(v, s, len, &json_default_allocator);
+}
+
+void set_string_with(json_value* v, const char* s, size_t len, const json_allocator* alloc)
 {
     assert(v != nullptr && (s != NULL || len == 0));
-    json_free(v);
-    v->s.s = (char *)malloc(len + 1);
-    memcpy((void *)v->s.s, s, len);
-    v->s.s[len] = '\0';
+    json_free_value(v, alloc);
+    v->s.s = string_dup(alloc, s, len);
     v->s.len = len;
+    v->s.capacity = len;
     v->type = STRING;
 }
 
@@ -87,9 +201,14 @@ size_t get_string_length(const json_value* v)
 }
 
 void set_boolean(json_value* v, int n)
+{
+    set_boolean_with(v, n, &json_default_allocator);
+}
+
+void set_boolean_with(json_value* v, int n, const json_allocator* alloc)
 {
     assert(v != NULL);
-    json_free(v);
+    json_free_value(v, alloc);
     v->type = n ? TRUE : FALSE;
     v->n = n;
 }
@@ -100,328 +219,2020 @@ int get_boolean(const json_value* v)
     return v->n;
 }
 
+/**
+ * 按分配器调整一块内存的大小，new_size 为0时释放并返回NULL
+*/
+void* resize_with(const json_allocator* alloc, void* ptr, size_t old_size, size_t new_size)
+{
+    if (new_size == 0) {
+        if (ptr) {
+            alloc->free_fn(alloc->user, ptr, old_size);
+        }
+        return NULL;
+    }
+    if (ptr == NULL) {
+        return alloc->malloc_fn(alloc->user, new_size);
+    }
+    return alloc->realloc_fn(alloc->user, ptr, old_size, new_size);
+}
+
+void set_array(json_value* v, size_t capacity)
+{
+    set_array_with(v, capacity, &json_default_allocator);
+}
+
+void set_array_with(json_value* v, size_t capacity, const json_allocator* alloc)
+{
+    assert(v != NULL);
+    json_free_value(v, alloc);
+    v->type = ARRAY;
+    v->a.size = 0;
+    v->a.capacity = capacity;
+    v->a.e = (json_value*)resize_with(alloc, NULL, 0, capacity * sizeof(json_value));
+}
+
 size_t get_array_size(const json_value* v) 
 {
     assert(v != NULL && v->type == ARRAY);
     return v->a.size;
 }
 
-json_value* get_array_element(const json_value* v, size_t index)
+size_t get_array_capacity(const json_value* v)
 {
     assert(v != NULL && v->type == ARRAY);
-    assert(index < v->a.size);
-    return &v->a.e[index];
+    return v->a.capacity;
 }
 
-void json_free(json_value* v)
+void reserve_array(json_value* v, size_t capacity)
 {
-    assert(v != NULL);
-    switch(v->type) 
-    {
-        case STRING :
-            free(v->s.s);
-            break;
-        case ARRAY :
-            for (size_t i = 0; i < v->a.size; i++){
-                json_free(&v->a.e[i]);
-            }
-            free(v->a.e);
-            break;
-        default: break;
-    }
-    v->type = JSON_NULL;
+    reserve_array_with(v, capacity, &json_default_allocator);
 }
 
-int parse(json_value *v, const char *json)
+void reserve_array_with(json_value* v, size_t capacity, const json_allocator* alloc)
 {
-    context c;
-    int ret;
-    assert(v != NULL);
-    c.json = json;
-    c.stack = NULL;
-    c.size = c.top = 0;
-    json_init(v);
-    parse_whitespace(&c);
-    if((ret = parse_value(&c, v)) == PARSE_OK){
-        parse_whitespace(&c);
-        if(*c.json != '\0'){
-            v->type = JSON_NULL;
-            ret = PARSE_ROOT_NOT_SINGULAR;
-        }
+    assert(v != NULL && v->type == ARRAY);
+    if (v->a.capacity < capacity) {
+        v->a.e = (json_value*)resize_with(alloc, v->a.e, v->a.capacity * sizeof(json_value), capacity * sizeof(json_value));
+        v->a.capacity = capacity;
     }
-    assert(c.top == 0);
-    free(c.stack);
-    return ret;
 }
 
-/**
- * json的状态机
-*/
-int parse_value(context *c, json_value* v)
+void shrink_array(json_value* v)
 {
-    switch(*c->json){
-        case 't': return parse_literal(c, v, "true", TRUE);
-        case 'f': return parse_literal(c, v, "false", FALSE);
-        case 'n': return parse_literal(c, v, "null", JSON_NULL);
-        case '"': return parse_string(c, v);
-        case '[': return parse_array(c, v);
-        case '\0': return PARSE_EXPCET_VALUE;
-        default : return parse_number(c, v);
-    }
+    shrink_array_with(v, &json_default_allocator);
 }
-/**
- * 判断json字符串的类型是null
-*/
-int parse_null(context *c, json_value* v)
+
+void shrink_array_with(json_value* v, const json_allocator* alloc)
 {
-    EXPECT(c,'n');
-    if(c->json[0] == 'u' && c->json[1] == 'l' && c->json[2] == 'l'){
-        v->type = JSON_NULL;
-        c->json += 3;
-        // if(*c->json != '\0') { return PARSE_ROOT_NOT_SINGULAR; }
-        return PARSE_OK;
+    assert(v != NULL && v->type == ARRAY);
+    if (v->a.capacity > v->a.size) {
+        v->a.e = (json_value*)resize_with(alloc, v->a.e, v->a.capacity * sizeof(json_value), v->a.size * sizeof(json_value));
+        v->a.capacity = v->a.size;
     }
-    return PARSE_INVALID_VALUE;
-} 
+}
 
-/**
- * 去除json字符串中的空格
-*/
-void parse_whitespace(context* c)
+void clear_array(json_value* v)
 {
-    const char* p = c->json;
-    while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'){
-        p++;
-    }
-    c->json = p;
+    clear_array_with(v, &json_default_allocator);
 }
 
-int parse_true(context *c, json_value *v){
-    EXPECT(c, 't');
-    if(c->json[0] == 'r' && c->json[1] == 'u' && c->json[2] == 'e'){
-        v->type = TRUE;
-        c->json += 3;
-        return PARSE_OK;
-    }
-    return PARSE_INVALID_VALUE;
+void clear_array_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == ARRAY);
+    erase_array_element_with(v, 0, v->a.size, alloc);
 }
 
-int parse_false(context *c, json_value *v){
-    EXPECT(c, 'f');
-    if(c->json[0] == 'a' && c->json[1] == 'l' && c->json[2] == 's' && c->json[3] == 'e'){
-        v->type = FALSE;
-        c->json += 4;
-        return PARSE_OK;
-    }
-    return PARSE_INVALID_VALUE;
+json_value* get_array_element(const json_value* v, size_t index)
+{
+    assert(v != NULL && v->type == ARRAY);
+    assert(index < v->a.size);
+    return &v->a.e[index];
 }
 
-/**
- * 字符转数字
-*/
-int parse_number(context *c, json_value *v){
-    const char* p = c->json;
-    if(*p == '-') p++;
-    if(*p == '0') p++;
-    else{
-        if(!ISDIGIT1TO9(*p)){
-            return PARSE_INVALID_VALUE;
-        }
-        p++;
-        while(ISDIGIT(*p)) p++;
-    }
-    if(*p == '.') {
-        p++;    
-        if(ISDIGIT(*p)){
-            p++;
-            while(ISDIGIT(*p)) p++;
-        }else{
-            return PARSE_INVALID_VALUE;
-        }
-    }
-    if(*p == 'e' || *p == 'E'){
-        p++;
-        if(*p == '-' || *p == '+'){
-            p++;
-        }
-        if(!ISDIGIT(*p)) return PARSE_INVALID_VALUE;
-        p++;
-        while(ISDIGIT(*p)) p++;
-    }
-    errno = 0;
-    v->n = strtod(c->json,NULL);
-    if(errno == ERANGE && (v->n == HUGE_VAL || v->n == -HUGE_VAL)){
-        return PARSE_NUMBER_TOO_BIG;
+json_value* pushback_array_element(json_value* v)
+{
+    return pushback_array_element_with(v, &json_default_allocator);
+}
+
+json_value* pushback_array_element_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == ARRAY);
+    if (v->a.size == v->a.capacity) {
+        reserve_array_with(v, v->a.capacity == 0 ? 1 : v->a.capacity * 2, alloc);
     }
-    v->type = NUMBER;
-    c->json = p;
-    return PARSE_OK;
-    
+    json_init(&v->a.e[v->a.size]);
+    return &v->a.e[v->a.size++];
+}
+
+void popback_array_element(json_value* v)
+{
+    popback_array_element_with(v, &json_default_allocator);
+}
+
+void popback_array_element_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == ARRAY && v->a.size > 0);
+    json_free_value(&v->a.e[--v->a.size], alloc);
 }
+
 /**
- * 处理字符串匹配
+ * 在index处插入一个null元素，后面的元素整体按位移动，不做深拷贝
 */
-int parse_literal(context *c, json_value *v, const char* literal, json_type type)
+json_value* insert_array_element(json_value* v, size_t index)
 {
-    int i;
-    EXPECT(c,literal[0]);
-    for(i = 0; literal[i + 1]; i++){
-        if(literal[i + 1] != c->json[i]){
-            return PARSE_INVALID_VALUE;
-        }
-    }
-    c->json += i;
-    v->type = type;
-    return PARSE_OK;
+    return insert_array_element_with(v, index, &json_default_allocator);
 }
 
-const char* parse_hex4(const char* p, unsigned *u)
+json_value* insert_array_element_with(json_value* v, size_t index, const json_allocator* alloc)
 {
-    *u = 0;
-    for (int i = 1; i <= 4; i++)
-    {
-        char ch = *p++;
-        *u <<= 4;
-        if      (ch >= '0' && ch <= '9') *u |= (ch - '0');
-        else if (ch >= 'A' && ch <= 'F') *u |= (ch - 'A') + 10;
-        else if (ch >= 'a' && ch <= 'f') *u |= (ch - 'a') + 10;
-        else return NULL;
+    assert(v != NULL && v->type == ARRAY && index <= v->a.size);
+    if (v->a.size == v->a.capacity) {
+        reserve_array_with(v, v->a.capacity == 0 ? 1 : v->a.capacity * 2, alloc);
     }
-    return p;
+    memmove(&v->a.e[index + 1], &v->a.e[index], (v->a.size - index) * sizeof(json_value));
+    v->a.size++;
+    json_init(&v->a.e[index]);
+    return &v->a.e[index];
 }
 
-void encode_utf8(context* c, unsigned u)
+void erase_array_element(json_value* v, size_t index, size_t count)
 {
-    if (u < 0x7F) {
-        PUTC(c, u & 0xFF);
-    }
-    else if (u <= 0x7FF) {
-        PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
-        PUTC(c, 0x80 | ( u       & 0x3F));
-    }
-    else if (u <= 0xFFFF) {
-        PUTC(c, 0xE0 | ((u >> 12) & 0xFF));
-        PUTC(c, 0x80 | ((u >> 6)  & 0x3F));
-        PUTC(c, 0x80 | ( u        & 0x3F));
+    erase_array_element_with(v, index, count, &json_default_allocator);
+}
+
+void erase_array_element_with(json_value* v, size_t index, size_t count, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == ARRAY && index + count <= v->a.size);
+    if (count == 0) {
+        return;
     }
-    else {
-        assert(u <= 0x10FFFF);
-        PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
-        PUTC(c, 0x80 | ((u >> 12) & 0x3F));
-        PUTC(c, 0x80 | ((u >> 6)  & 0x3F));
-        PUTC(c, 0x80 | ( u        & 0x3F));
+    for (size_t i = index; i < index + count; i++) {
+        json_free_value(&v->a.e[i], alloc);
     }
+    memmove(&v->a.e[index], &v->a.e[index + count], (v->a.size - index - count) * sizeof(json_value));
+    v->a.size -= count;
 }
 
-#define STRING_ERROR(ret) do{ c->top = head; return ret; }while(0)
+void set_object(json_value* v, size_t capacity)
+{
+    set_object_with(v, capacity, &json_default_allocator);
+}
 
-int parse_string(context* c, json_value* v)  
+void set_object_with(json_value* v, size_t capacity, const json_allocator* alloc)
 {
-    size_t head = c->top, len;
-    unsigned u, u2;
-    const char* p;
-    EXPECT(c, '\"');
-    p = c->json;
-    while(1)
-    {
-        char ch = *p++;
-        switch (ch) {
+    assert(v != NULL);
+    json_free_value(v, alloc);
+    v->type = OBJECT;
+    v->o.size = 0;
+    v->o.capacity = capacity;
+    v->o.m = (json_member*)resize_with(alloc, NULL, 0, capacity * sizeof(json_member));
+}
+
+size_t get_object_size(const json_value* v)
+{
+    assert(v != NULL && v->type == OBJECT);
+    return v->o.size;
+}
+
+size_t get_object_capacity(const json_value* v)
+{
+    assert(v != NULL && v->type == OBJECT);
+    return v->o.capacity;
+}
+
+void reserve_object(json_value* v, size_t capacity)
+{
+    reserve_object_with(v, capacity, &json_default_allocator);
+}
+
+void reserve_object_with(json_value* v, size_t capacity, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT);
+    if (v->o.capacity < capacity) {
+        v->o.m = (json_member*)resize_with(alloc, v->o.m, v->o.capacity * sizeof(json_member), capacity * sizeof(json_member));
+        v->o.capacity = capacity;
+    }
+}
+
+void shrink_object(json_value* v)
+{
+    shrink_object_with(v, &json_default_allocator);
+}
+
+void shrink_object_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT);
+    if (v->o.capacity > v->o.size) {
+        v->o.m = (json_member*)resize_with(alloc, v->o.m, v->o.capacity * sizeof(json_member), v->o.size * sizeof(json_member));
+        v->o.capacity = v->o.size;
+    }
+}
+
+void clear_object(json_value* v)
+{
+    clear_object_with(v, &json_default_allocator);
+}
+
+void clear_object_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT);
+    for (size_t i = 0; i < v->o.size; i++) {
+        alloc->free_fn(alloc->user, v->o.m[i].k, v->o.m[i].klen + 1);
+        json_free_value(&v->o.m[i].v, alloc);
+    }
+    v->o.size = 0;
+}
+
+const char* get_object_key(const json_value* v, size_t index)
+{
+    assert(v != NULL && v->type == OBJECT);
+    assert(index < v->o.size);
+    return v->o.m[index].k;
+}
+
+size_t get_object_key_length(const json_value* v, size_t index)
+{
+    assert(v != NULL && v->type == OBJECT);
+    assert(index < v->o.size);
+    return v->o.m[index].klen;
+}
+
+json_value* get_object_value(const json_value* v, size_t index)
+{
+    assert(v != NULL && v->type == OBJECT);
+    assert(index < v->o.size);
+    return &v->o.m[index].v;
+}
+
+size_t find_object_index(const json_value* v, const char* key, size_t klen)
+{
+    assert(v != NULL && v->type == OBJECT && key != NULL);
+    for (size_t i = 0; i < v->o.size; i++) {
+        if (v->o.m[i].klen == klen && memcmp(v->o.m[i].k, key, klen) == 0) {
+            return i;
+        }
+    }
+    return KEY_NOT_EXIST;
+}
+
+json_value* find_object_value(const json_value* v, const char* key, size_t klen)
+{
+    size_t index = find_object_index(v, key, klen);
+    return index != KEY_NOT_EXIST ? &v->o.m[index].v : NULL;
+}
+
+json_value* set_object_value(json_value* v, const char* key, size_t klen)
+{
+    return set_object_value_with(v, key, klen, &json_default_allocator);
+}
+
+json_value* set_object_value_with(json_value* v, const char* key, size_t klen, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && key != NULL);
+    json_value* found = find_object_value(v, key, klen);
+    return found ? found : pushback_object_member_with(v, key, klen, alloc);
+}
+
+json_value* pushback_object_member(json_value* v, const char* key, size_t klen)
+{
+    return pushback_object_member_with(v, key, klen, &json_default_allocator);
+}
+
+/**
+ * 不查重直接追加，均摊 O(1)；调用者需保证键不重复(或有意保留重复键)
+*/
+json_value* pushback_object_member_with(json_value* v, const char* key, size_t klen, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && key != NULL);
+    if (v->o.size == v->o.capacity) {
+        reserve_object_with(v, v->o.capacity == 0 ? 1 : v->o.capacity * 2, alloc);
+    }
+    json_member* m = &v->o.m[v->o.size++];
+    m->k = string_dup(alloc, key, klen);
+    m->klen = klen;
+    json_init(&m->v);
+    return &m->v;
+}
+
+void popback_object_member(json_value* v)
+{
+    popback_object_member_with(v, &json_default_allocator);
+}
+
+void popback_object_member_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && v->o.size > 0);
+    json_member* m = &v->o.m[--v->o.size];
+    alloc->free_fn(alloc->user, m->k, m->klen + 1);
+    json_free_value(&m->v, alloc);
+}
+
+/**
+ * 在index处插入一个键为key、值为null的成员，不查重；后面的成员整体按位移动
+*/
+json_value* insert_object_member(json_value* v, size_t index, const char* key, size_t klen)
+{
+    return insert_object_member_with(v, index, key, klen, &json_default_allocator);
+}
+
+json_value* insert_object_member_with(json_value* v, size_t index, const char* key, size_t klen, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && key != NULL && index <= v->o.size);
+    if (v->o.size == v->o.capacity) {
+        reserve_object_with(v, v->o.capacity == 0 ? 1 : v->o.capacity * 2, alloc);
+    }
+    char* k = string_dup(alloc, key, klen);
+    memmove(&v->o.m[index + 1], &v->o.m[index], (v->o.size - index) * sizeof(json_member));
+    v->o.size++;
+    json_member* m = &v->o.m[index];
+    m->k = k;
+    m->klen = klen;
+    json_init(&m->v);
+    return &m->v;
+}
+
+void erase_object_member(json_value* v, size_t index, size_t count)
+{
+    erase_object_member_with(v, index, count, &json_default_allocator);
+}
+
+void erase_object_member_with(json_value* v, size_t index, size_t count, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && index + count <= v->o.size);
+    if (count == 0) {
+        return;
+    }
+    for (size_t i = index; i < index + count; i++) {
+        alloc->free_fn(alloc->user, v->o.m[i].k, v->o.m[i].klen + 1);
+        json_free_value(&v->o.m[i].v, alloc);
+    }
+    memmove(&v->o.m[index], &v->o.m[index + count], (v->o.size - index - count) * sizeof(json_member));
+    v->o.size -= count;
+}
+
+void remove_object_value(json_value* v, size_t index)
+{
+    remove_object_value_with(v, index, &json_default_allocator);
+}
+
+void remove_object_value_with(json_value* v, size_t index, const json_allocator* alloc)
+{
+    assert(v != NULL && v->type == OBJECT && index < v->o.size);
+    erase_object_member_with(v, index, 1, alloc);
+}
+
+void json_free(json_value* v)
+{
+    json_free_with(v, &json_default_allocator);
+}
+
+/**
+ * 递归释放，库内部的重置和出错清理都走这里；只有公开的 json_free/json_free_with 计入 PROFILE_FREE
+*/
+void json_free_value(json_value* v, const json_allocator* alloc)
+{
+    switch(v->type) 
+    {
+        case STRING :
+            alloc->free_fn(alloc->user, v->s.s, v->s.capacity + 1);
+            break;
+        case ARRAY :
+            for (size_t i = 0; i < v->a.size; i++){
+                json_free_value(&v->a.e[i], alloc);
+            }
+            if (v->a.e) {
+                alloc->free_fn(alloc->user, v->a.e, v->a.capacity * sizeof(json_value));
+            }
+            break;
+        case OBJECT :
+            for (size_t i = 0; i < v->o.size; i++){
+                alloc->free_fn(alloc->user, v->o.m[i].k, v->o.m[i].klen + 1);
+                json_free_value(&v->o.m[i].v, alloc);
+            }
+            if (v->o.m) {
+                alloc->free_fn(alloc->user, v->o.m, v->o.capacity * sizeof(json_member));
+            }
+            break;
+        default: break;
+    }
+    v->type = JSON_NULL;
+}
+
+void json_free_with(json_value* v, const json_allocator* alloc)
+{
+    assert(v != NULL && alloc != NULL);
+    PROFILE_SCOPE(PROFILE_FREE);
+    json_free_value(v, alloc);
+}
+
+/**
+ * 深拷贝。源树的大小已知，数组、对象和字符串都按精确大小一次分配，不走增长路径
+*/
+void json_copy(json_value* dst, const json_value* src)
+{
+    json_copy_with(dst, src, &json_default_allocator);
+}
+
+void json_copy_with(json_value* dst, const json_value* src, const json_allocator* alloc)
+{
+    assert(src != NULL && dst != NULL && src != dst && alloc != NULL);
+    json_free_value(dst, alloc);
+    switch (src->type)
+    {
+        case STRING :
+            dst->s.s = string_dup(alloc, src->s.s, src->s.len);
+            dst->s.len = src->s.len;
+            dst->s.capacity = src->s.len;
+            dst->type = STRING;
+            break;
+        case ARRAY :
+            dst->a.size = dst->a.capacity = src->a.size;
+            dst->a.e = src->a.size > 0 ? (json_value*)alloc->malloc_fn(alloc->user, src->a.size * sizeof(json_value)) : NULL;
+            for (size_t i = 0; i < src->a.size; i++) {
+                json_init(&dst->a.e[i]);
+                json_copy_with(&dst->a.e[i], &src->a.e[i], alloc);
+            }
+            dst->type = ARRAY;
+            break;
+        case OBJECT :
+            dst->o.size = dst->o.capacity = src->o.size;
+            dst->o.m = src->o.size > 0 ? (json_member*)alloc->malloc_fn(alloc->user, src->o.size * sizeof(json_member)) : NULL;
+            for (size_t i = 0; i < src->o.size; i++) {
+                json_member* m = &dst->o.m[i];
+                m->klen = src->o.m[i].klen;
+                m->k = string_dup(alloc, src->o.m[i].k, m->klen);
+                json_init(&m->v);
+                json_copy_with(&m->v, &src->o.m[i].v, alloc);
+            }
+            dst->type = OBJECT;
+            break;
+        default :
+            memcpy(dst, src, sizeof(json_value));
+            break;
+    }
+}
+
+void json_move(json_value* dst, json_value* src)
+{
+    json_move_with(dst, src, &json_default_allocator);
+}
+
+void json_move_with(json_value* dst, json_value* src, const json_allocator* alloc)
+{
+    assert(dst != NULL && src != NULL && src != dst);
+    json_free_value(dst, alloc);
+    memcpy(dst, src, sizeof(json_value));
+    json_init(src);
+}
+
+void json_swap(json_value* lhs, json_value* rhs)
+{
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs != rhs) {
+        json_value temp;
+        memcpy(&temp, lhs, sizeof(json_value));
+        memcpy(lhs, rhs, sizeof(json_value));
+        memcpy(rhs, &temp, sizeof(json_value));
+    }
+}
+
+int member_equal(const json_member* lhs, const json_member* rhs)
+{
+    return lhs->klen == rhs->klen && memcmp(lhs->k, rhs->k, lhs->klen) == 0 && json_equal(&lhs->v, &rhs->v);
+}
+
+uint64_t member_hash(const json_member* m);
+
+typedef struct {
+    const json_member* m;
+    uint64_t h;
+}member_entry;
+
+/* 先按成员哈希、再按键排序，键和哈希都相同的成员排在一起 */
+int member_entry_compare(const void* a, const void* b)
+{
+    const member_entry* x = (const member_entry*)a;
+    const member_entry* y = (const member_entry*)b;
+    if (x->h != y->h) {
+        return x->h < y->h ? -1 : 1;
+    }
+    if (x->m->klen != y->m->klen) {
+        return x->m->klen < y->m->klen ? -1 : 1;
+    }
+    return memcmp(x->m->k, y->m->k, x->m->klen);
+}
+
+#define MEMBER_SCAN_LIMIT 16
+
+/**
+ * 剩余成员很少时直接计数：每组相等的成员只在第一次出现时数，两边个数必须相同
+*/
+int object_members_equal_scan(const json_value* lhs, const json_value* rhs, size_t start)
+{
+    size_t n = lhs->o.size;
+    for (size_t i = start; i < n; i++) {
+        const json_member* m = &lhs->o.m[i];
+        size_t j, left = 0, right = 0;
+        for (j = start; j < i && !member_equal(&lhs->o.m[j], m); j++) {
+        }
+        if (j < i) {
+            continue;
+        }
+        for (j = i; j < n; j++) {
+            left += member_equal(&lhs->o.m[j], m);
+        }
+        for (j = start; j < n && right <= left; j++) {
+            right += member_equal(&rhs->o.m[j], m);
+        }
+        if (left != right) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * 比较两个对象从 start 起的成员多重集合，O(n log n)
+ * 两边各建一个按 (哈希, 键) 排序的下标数组，逐组比较：组的大小必须相同，
+ * 组内再用 json_equal 一一配对(哈希碰撞时组内值不一定相等)
+*/
+int object_members_equal(const json_value* lhs, const json_value* rhs, size_t start)
+{
+    size_t count = lhs->o.size - start, i, j, k, end;
+    if (count <= MEMBER_SCAN_LIMIT) {
+        return object_members_equal_scan(lhs, rhs, start);
+    }
+    member_entry* left = (member_entry*)malloc(2 * count * sizeof(member_entry));
+    member_entry* right = left + count;
+    int equal = 1;
+    for (i = 0; i < count; i++) {
+        left[i].m = &lhs->o.m[start + i];
+        left[i].h = member_hash(left[i].m);
+        right[i].m = &rhs->o.m[start + i];
+        right[i].h = member_hash(right[i].m);
+    }
+    qsort(left, count, sizeof(member_entry), member_entry_compare);
+    qsort(right, count, sizeof(member_entry), member_entry_compare);
+    for (i = 0; i < count && equal; i = end) {
+        for (end = i + 1; end < count && member_entry_compare(&left[i], &left[end]) == 0; end++) {
+        }
+        if (member_entry_compare(&left[i], &right[i]) != 0 || member_entry_compare(&left[i], &right[end - 1]) != 0
+            || (end < count && member_entry_compare(&left[i], &right[end]) == 0)) {
+            equal = 0;
+            break;
+        }
+        /* 已配对的右侧成员换到组的前部 */
+        for (j = i; j < end && equal; j++) {
+            for (k = j; k < end && !json_equal(&left[j].m->v, &right[k].m->v); k++) {
+            }
+            if (k == end) {
+                equal = 0;
+            }
+            else {
+                member_entry tmp = right[j];
+                right[j] = right[k];
+                right[k] = tmp;
+            }
+        }
+    }
+    free(left);
+    return equal;
+}
+
+/**
+ * 先比较类型和大小，不同立即返回
+ * 对象按成员的多重集合比较：重复键逐个一一对应，与顺序无关，与 json_hash 的成员求和一致
+ * 成员顺序通常一致，先按下标比较，从第一处对不上的位置起交给 object_members_equal
+*/
+int json_equal(const json_value* lhs, const json_value* rhs)
+{
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs == rhs) {
+        return 1;
+    }
+    if (lhs->type != rhs->type) {
+        return 0;
+    }
+    switch (lhs->type)
+    {
+        case NUMBER :
+            return lhs->n == rhs->n;
+        case STRING :
+            return lhs->s.len == rhs->s.len && memcmp(lhs->s.s, rhs->s.s, lhs->s.len) == 0;
+        case ARRAY :
+            if (lhs->a.size != rhs->a.size) {
+                return 0;
+            }
+            for (size_t i = 0; i < lhs->a.size; i++) {
+                if (!json_equal(&lhs->a.e[i], &rhs->a.e[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        case OBJECT : {
+            size_t n = lhs->o.size, start = 0;
+            if (n != rhs->o.size) {
+                return 0;
+            }
+            while (start < n && member_equal(&lhs->o.m[start], &rhs->o.m[start])) {
+                start++;
+            }
+            return start == n || object_members_equal(lhs, rhs, start);
+        }
+        default :
+            return 1;
+    }
+}
+
+#define HASH_MUL 0x9E3779B97F4A7C15ULL
+
+uint64_t hash_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * 每次读入8字节的字符串哈希
+*/
+uint64_t hash_bytes(const char* s, size_t len, uint64_t seed)
+{
+    uint64_t h = seed ^ (len * HASH_MUL);
+    uint64_t w;
+    while (len >= 8) {
+        memcpy(&w, s, 8);
+        h = (h ^ hash_mix(w)) * HASH_MUL;
+        s += 8;
+        len -= 8;
+    }
+    w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ hash_mix(w)) * HASH_MUL;
+    return hash_mix(h);
+}
+
+uint64_t hash_value(const json_value* v);
+
+uint64_t member_hash(const json_member* m)
+{
+    return hash_mix(hash_bytes(m->k, m->klen, 0) ^ (hash_value(&m->v) * HASH_MUL));
+}
+
+uint64_t hash_value(const json_value* v)
+{
+    uint64_t h = (uint64_t)(v->type + 1) * HASH_MUL;
+    switch (v->type)
+    {
+        case NUMBER : {
+            double n = v->n == 0.0 ? 0.0 : v->n;  /* -0 == 0 */
+            uint64_t bits;
+            memcpy(&bits, &n, sizeof(bits));
+            return hash_mix(h ^ bits);
+        }
+        case STRING :
+            return hash_bytes(v->s.s, v->s.len, h);
+        case ARRAY :
+            h ^= v->a.size;
+            for (size_t i = 0; i < v->a.size; i++) {
+                h = (h ^ hash_value(&v->a.e[i])) * HASH_MUL;
+            }
+            return hash_mix(h);
+        case OBJECT : {
+            /* 成员哈希相加：与顺序无关，重复的成员各计一次，与 json_equal 的一一对应一致 */
+            uint64_t sum = 0;
+            for (size_t i = 0; i < v->o.size; i++) {
+                sum += member_hash(&v->o.m[i]);
+            }
+            return hash_mix(h ^ v->o.size ^ sum);
+        }
+        default :
+            return hash_mix(h);
+    }
+}
+
+size_t json_hash(const json_value* v)
+{
+    assert(v != NULL);
+    return (size_t)hash_value(v);
+}
+
+int parse(json_value *v, const char *json)
+{
+    return parse_with_options(v, json, NULL);
+}
+
+int parse_with_flags(json_value *v, const char *json, unsigned flags)
+{
+    parse_options opt = { flags, NULL, NULL };
+    return parse_with_options(v, json, &opt);
+}
+
+void context_init(context* c, const char* json, const parse_options* opt)
+{
+    assert(c != NULL && json != NULL);
+    c->json = json;
+    c->stack = NULL;
+    c->size = c->top = 0;
+    c->flags = opt ? opt->flags : PARSE_FLAG_DEFAULT;
+    c->alloc = opt && opt->allocator ? opt->allocator : &json_default_allocator;
+    c->stats = opt ? opt->stats : NULL;
+    c->depth = 0;
+    if (c->stats) {
+        memset(c->stats, 0, sizeof(parse_stats));
+    }
+}
+
+void context_release(context* c)
+{
+    assert(c->top == 0);
+    if (c->stack) {
+        c->alloc->free_fn(c->alloc->user, c->stack, c->size);
+    }
+    c->stack = NULL;
+    c->size = 0;
+}
+
+int parse_with_options(json_value *v, const char *json, const parse_options *opt)
+{
+    context c;
+    int ret;
+    assert(v != NULL);
+    context_init(&c, json, opt);
+    json_init(v);
+    parse_whitespace(&c);
+    if((ret = parse_value(&c, v)) == PARSE_OK){
+        parse_whitespace(&c);
+        if(*c.json != '\0'){
+            json_free_value(v, c.alloc);
+            ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+    PROFILE_COUNT(input_bytes, c.json - json);
+    context_release(&c);
+    return ret;
+}
+
+/**
+ * json的状态机
+*/
+int parse_value(context *c, json_value* v)
+{
+    switch(*c->json){
+        case 't': return parse_literal(c, v, "true", TRUE);
+        case 'f': return parse_literal(c, v, "false", FALSE);
+        case 'n': return parse_literal(c, v, "null", JSON_NULL);
+        case '"': return parse_string(c, v);
+        case '[': return parse_array(c, v);
+        case '{': return parse_object(c, v);
+        case '\0': return PARSE_EXPCET_VALUE;
+        default : return parse_number(c, v);
+    }
+}
+/**
+ * 判断json字符串的类型是null
+*/
+int parse_null(context *c, json_value* v)
+{
+    EXPECT(c,'n');
+    if(c->json[0] == 'u' && c->json[1] == 'l' && c->json[2] == 'l'){
+        v->type = JSON_NULL;
+        c->json += 3;
+        // if(*c->json != '\0') { return PARSE_ROOT_NOT_SINGULAR; }
+        return PARSE_OK;
+    }
+    return PARSE_INVALID_VALUE;
+} 
+
+/**
+ * 去除json字符串中的空格
+*/
+void parse_whitespace(context* c)
+{
+    PROFILE_SCOPE(PROFILE_WHITESPACE);
+    const char* p = c->json;
+    while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'){
+        p++;
+    }
+    PROFILE_COUNT(whitespace_bytes, p - c->json);
+    c->json = p;
+}
+
+int parse_true(context *c, json_value *v){
+    EXPECT(c, 't');
+    if(c->json[0] == 'r' && c->json[1] == 'u' && c->json[2] == 'e'){
+        v->type = TRUE;
+        c->json += 3;
+        return PARSE_OK;
+    }
+    return PARSE_INVALID_VALUE;
+}
+
+int parse_false(context *c, json_value *v){
+    EXPECT(c, 'f');
+    if(c->json[0] == 'a' && c->json[1] == 'l' && c->json[2] == 's' && c->json[3] == 'e'){
+        v->type = FALSE;
+        c->json += 4;
+        return PARSE_OK;
+    }
+    return PARSE_INVALID_VALUE;
+}
+
+/**
+ * 按JSON数字语法扫描，返回数字之后的位置，语法错误返回NULL
+ * *integral 表示没有小数和指数部分
+*/
+const char* scan_number(const char* p, int* integral)
+{
+    *integral = 1;
+    if(*p == '-') p++;
+    if(*p == '0') p++;
+    else{
+        if(!ISDIGIT1TO9(*p)){
+            return NULL;
+        }
+        p++;
+        while(ISDIGIT(*p)) p++;
+    }
+    if(*p == '.') {
+        p++;    
+        if(ISDIGIT(*p)){
+            p++;
+            while(ISDIGIT(*p)) p++;
+        }else{
+            return NULL;
+        }
+        *integral = 0;
+    }
+    if(*p == 'e' || *p == 'E'){
+        p++;
+        if(*p == '-' || *p == '+'){
+            p++;
+        }
+        if(!ISDIGIT(*p)) return NULL;
+        p++;
+        while(ISDIGIT(*p)) p++;
+        *integral = 0;
+    }
+    return p;
+}
+
+/**
+ * 字符转数字
+*/
+int parse_number(context *c, json_value *v){
+    PROFILE_SCOPE(PROFILE_NUMBER);
+    int integral;
+    const char* p = scan_number(c->json, &integral);
+    if (p == NULL) {
+        return PARSE_INVALID_VALUE;
+    }
+    errno = 0;
+    {
+        PROFILE_SCOPE(PROFILE_STRTOD);
+        v->n = strtod(c->json,NULL);
+    }
+    if(errno == ERANGE && (v->n == HUGE_VAL || v->n == -HUGE_VAL)){
+        return PARSE_NUMBER_TOO_BIG;
+    }
+    v->type = NUMBER;
+    PROFILE_COUNT(number_bytes, p - c->json);
+    c->json = p;
+    return PARSE_OK;
+    
+}
+
+/**
+ * 把数字按64位整数读出，不经过 double，超过 2^53 也不丢精度
+ * 语法错误返回 PARSE_INVALID_VALUE；带小数或指数、或超出范围返回 PARSE_TYPE_MISMATCH
+*/
+int parse_int64(context* c, long long* out)
+{
+    PROFILE_SCOPE(PROFILE_NUMBER);
+    int integral;
+    const char* p = scan_number(c->json, &integral);
+    if (p == NULL) {
+        return PARSE_INVALID_VALUE;
+    }
+    if (!integral) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    errno = 0;
+    *out = strtoll(c->json, NULL, 10);
+    if (errno == ERANGE) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    PROFILE_COUNT(number_bytes, p - c->json);
+    c->json = p;
+    return PARSE_OK;
+}
+
+/* 负数只接受 -0 */
+int parse_uint64(context* c, unsigned long long* out)
+{
+    PROFILE_SCOPE(PROFILE_NUMBER);
+    int integral;
+    const char* p = scan_number(c->json, &integral);
+    if (p == NULL) {
+        return PARSE_INVALID_VALUE;
+    }
+    if (!integral || (*c->json == '-' && c->json[1] != '0')) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    errno = 0;
+    *out = strtoull(c->json, NULL, 10);
+    if (errno == ERANGE) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    PROFILE_COUNT(number_bytes, p - c->json);
+    c->json = p;
+    return PARSE_OK;
+}
+/**
+ * 处理字符串匹配
+*/
+int parse_literal(context *c, json_value *v, const char* literal, json_type type)
+{
+    int i;
+    EXPECT(c,literal[0]);
+    for(i = 0; literal[i + 1]; i++){
+        if(literal[i + 1] != c->json[i]){
+            return PARSE_INVALID_VALUE;
+        }
+    }
+    c->json += i;
+    v->type = type;
+    PROFILE_COUNT(literal_bytes, i + 1);
+    return PARSE_OK;
+}
+
+const char* parse_hex4(const char* p, unsigned *u)
+{
+    *u = 0;
+    for (int i = 1; i <= 4; i++)
+    {
+        char ch = *p++;
+        *u <<= 4;
+        if      (ch >= '0' && ch <= '9') *u |= (ch - '0');
+        else if (ch >= 'A' && ch <= 'F') *u |= (ch - 'A') + 10;
+        else if (ch >= 'a' && ch <= 'f') *u |= (ch - 'a') + 10;
+        else return NULL;
+    }
+    return p;
+}
+
+void encode_utf8(context* c, unsigned u)
+{
+    if (u <= 0x7F) {
+        PUTC(c, u & 0xFF);
+    }
+    else if (u <= 0x7FF) {
+        PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
+        PUTC(c, 0x80 | ( u       & 0x3F));
+    }
+    else if (u <= 0xFFFF) {
+        PUTC(c, 0xE0 | ((u >> 12) & 0xFF));
+        PUTC(c, 0x80 | ((u >> 6)  & 0x3F));
+        PUTC(c, 0x80 | ( u        & 0x3F));
+    }
+    else {
+        assert(u <= 0x10FFFF);
+        PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
+        PUTC(c, 0x80 | ((u >> 12) & 0x3F));
+        PUTC(c, 0x80 | ((u >> 6)  & 0x3F));
+        PUTC(c, 0x80 | ( u        & 0x3F));
+    }
+}
+
+/**
+ * 校验p处的一个多字节UTF-8序列(RFC 3629)，成功返回序列之后的位置，失败返回NULL
+ * 字符串结尾的'\0'不是合法的后续字节，因此不会越界读取
+*/
+const char* parse_utf8_sequence(const char* p)
+{
+    const unsigned char* s = (const unsigned char*)p;
+    unsigned char lo = 0x80, hi = 0xBF;
+    int n;
+    if      (s[0] >= 0xC2 && s[0] <= 0xDF) n = 1;
+    else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+        n = 2;
+        if (s[0] == 0xE0) lo = 0xA0;  /* 过长编码 */
+        if (s[0] == 0xED) hi = 0x9F;  /* 代理区 U+D800..U+DFFF */
+    }
+    else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+        n = 3;
+        if (s[0] == 0xF0) lo = 0x90;  /* 过长编码 */
+        if (s[0] == 0xF4) hi = 0x8F;  /* 超过 U+10FFFF */
+    }
+    else return NULL;
+    if (s[1] < lo || s[1] > hi) return NULL;
+    for (int i = 2; i <= n; i++) {
+        if ((s[i] & 0xC0) != 0x80) return NULL;
+    }
+    return p + n + 1;
+}
+
+/**
+ * 扫描字符串中无需转义处理的一段字节，返回第一个 '"'、'\\'、控制字符
+ * 或(需要校验时)无效UTF-8序列的位置
+*/
+const char* scan_string_scalar(const char* p, int validate)
+{
+    while(1) {
+        unsigned char ch = (unsigned char)*p;
+        if (ch == '\"' || ch == '\\' || ch < 0x20) {
+            return p;
+        }
+        if (ch < 0x80 || !validate) {
+            p++;
+        }
+        else {
+            const char* q = parse_utf8_sequence(p);
+            if (!q) return p;
+            p = q;
+        }
+    }
+}
+
+#ifdef JSON_SSE2
+#define SSE2_MASK(cmp) ((unsigned)_mm_movemask_epi8(cmp))
+#define SSE2_BYTE(x) _mm_set1_epi8((char)(x))
+
+/**
+ * 每次读入一个对齐的16字节块，同一个块上完成结束符检测和UTF-8分类：
+ * 后续字节和各长度的首字节变成16位掩码，首字节掩码左移得到"应为后续字节"的位置，
+ * 与实际后续字节掩码比较，跨块的序列把左移溢出的位带到下一块；
+ * E0/ED/F0/F4 对第二个字节的范围限制用错开一个字节的向量直接比较
+ * 块内遇到结束符或校验失败时，从该块(或跨入该块的未完成序列的首字节)起逐字节扫描，精确定位
+ * 首块从p所在的对齐位置读起，p之前的位全部屏蔽，短字符串也走块检测
+ * 对齐的16字节读取不会跨页，可能读到p之前或'\0'之后几个字节，故对ASan关闭检测
+*/
+__attribute__((no_sanitize_address))
+const char* scan_string_run(const char* p, int validate)
+{
+    const char* block = (const char*)((uintptr_t)p & ~(uintptr_t)15);
+    unsigned live = 0xFFFFu << (p - block) & 0xFFFFu;
+    unsigned paired = live & live << 1;    /* p 所在位置的前一个字节不属于本段，不参与范围检查 */
+    unsigned need = 0;    /* 上一块带过来的"应为后续字节"位 */
+    __m128i prev = _mm_setzero_si128();
+    while(1) {
+        __m128i b = _mm_load_si128((const __m128i*)block);
+        unsigned stop = SSE2_MASK(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, SSE2_BYTE('\"')),
+                                                            _mm_cmpeq_epi8(b, SSE2_BYTE('\\'))),
+                                               _mm_cmpeq_epi8(_mm_max_epu8(b, SSE2_BYTE(0x1F)), SSE2_BYTE(0x1F))));
+        unsigned high = SSE2_MASK(b) & live;
+        if (stop & live) {
+            break;
+        }
+        if (validate && (high | need)) {
+            /* 有符号比较：0x80..0xFF 为负数，ASCII 不会落入任何区间 */
+            unsigned cont = SSE2_MASK(_mm_cmplt_epi8(b, SSE2_BYTE(0xC0))) & live;
+            unsigned lead2 = SSE2_MASK(_mm_and_si128(_mm_cmpgt_epi8(b, SSE2_BYTE(0xC1)),
+                                                     _mm_cmplt_epi8(b, SSE2_BYTE(0xE0)))) & live;
+            unsigned lead3 = SSE2_MASK(_mm_and_si128(_mm_cmpgt_epi8(b, SSE2_BYTE(0xDF)),
+                                                     _mm_cmplt_epi8(b, SSE2_BYTE(0xF0)))) & live;
+            unsigned lead4 = SSE2_MASK(_mm_and_si128(_mm_cmpgt_epi8(b, SSE2_BYTE(0xEF)),
+                                                     _mm_cmplt_epi8(b, SSE2_BYTE(0xF5)))) & live;
+            /* 每个位置的前一个字节；range 标出第二个字节超出范围的位置 */
+            __m128i before = _mm_or_si128(_mm_slli_si128(b, 1), _mm_srli_si128(prev, 15));
+            __m128i below_a0 = _mm_cmplt_epi8(b, SSE2_BYTE(0xA0));
+            __m128i below_90 = _mm_cmplt_epi8(b, SSE2_BYTE(0x90));
+            __m128i below_c0 = _mm_cmplt_epi8(b, SSE2_BYTE(0xC0));
+            __m128i range = _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(before, SSE2_BYTE(0xE0)), below_a0),
+                             _mm_and_si128(_mm_cmpeq_epi8(before, SSE2_BYTE(0xF0)), below_90)),
+                _mm_or_si128(_mm_andnot_si128(below_a0, _mm_and_si128(_mm_cmpeq_epi8(before, SSE2_BYTE(0xED)), below_c0)),
+                             _mm_andnot_si128(below_90, _mm_and_si128(_mm_cmpeq_epi8(before, SSE2_BYTE(0xF4)), below_c0))));
+            unsigned lead = lead2 | lead3 | lead4;
+            unsigned expect = need | lead << 1 | (lead3 | lead4) << 2 | lead4 << 3;
+            unsigned bad = ((expect & 0xFFFFu) ^ cont) | (high & ~(cont | lead));
+            bad |= SSE2_MASK(range) & paired;
+            if (bad & 0xFFFFu) {
+                break;
+            }
+            need = expect >> 16;
+        }
+        prev = b;
+        block += 16;
+        live = paired = 0xFFFFu;
+    }
+    if (live != 0xFFFFu) {
+        return scan_string_scalar(p, validate);
+    }
+    if (need) {
+        /* 上一块已校验过，未完成序列的首字节最多在3个字节之前 */
+        do {
+            block--;
+        } while (((unsigned char)*block & 0xC0) == 0x80);
+    }
+    return scan_string_scalar(block, validate);
+}
+
+#undef SSE2_MASK
+#undef SSE2_BYTE
+#else
+const char* scan_string_run(const char* p, int validate)
+{
+    return scan_string_scalar(p, validate);
+}
+#endif
+
+/**
+ * 解析 \\u 之后的4位十六进制，高代理项必须紧跟一个低代理项
+ * *pp 指向 'u' 之后，成功时移到转义序列之后
+*/
+int parse_unicode_escape(const char** pp, unsigned* u)
+{
+    const char* p = *pp;
+    unsigned u2;
+    if (!(p = parse_hex4(p, u))) {
+        return PARSE_INVALID_UNICODE_HEX;
+    }
+    PROFILE_COUNT(unicode_escapes, 1);
+    if (*u >= 0xD800 && *u <= 0xDBFF) {
+        PROFILE_COUNT(surrogate_pairs, 1);
+        if (*p++ != '\\') {
+            return PARSE_INVALID_UNICODE_SURROGATE;
+        }
+        if (*p++ != 'u') {
+            return PARSE_INVALID_UNICODE_SURROGATE;
+        }
+        if (!(p = parse_hex4(p, &u2))) {
+            return PARSE_INVALID_UNICODE_HEX;
+        }
+        if (u2 < 0xDC00 || u2 > 0xDFFF) {
+            return PARSE_INVALID_UNICODE_SURROGATE;
+        }
+        *u = (((*u - 0xD800) << 10) + (u2 -0xDC00) + 0x10000);
+    }
+    *pp = p;
+    return PARSE_OK;
+}
+
+/**
+ * 只校验并跳过一个字符串，不解码也不使用解析栈
+*/
+int parse_string_skip(context* c)
+{
+    unsigned u;
+    int ret;
+    const char* p;
+    int validate = !(c->flags & PARSE_FLAG_NO_UTF8_VALIDATION);
+    PROFILE_SCOPE(PROFILE_STRING);
+    EXPECT(c, '\"');
+    p = c->json;
+    while(1)
+    {
+        p = scan_string_run(p, validate);
+        char ch = *p++;
+        switch (ch) {
+            case '\"':
+                PROFILE_COUNT(string_bytes, p - c->json + 1);
+                c->json = p;
+                return PARSE_OK;
+            case '\0':
+                return PARSE_MISS_QUOTATION_MARK;
+            case '\\':
+                PROFILE_COUNT(escapes, 1);
+                switch(*p++) {
+                    case '\"': case '\\': case '/':
+                    case 'b': case 'f': case 'n': case 'r': case 't':
+                        break;
+                    case 'u':
+                        if ((ret = parse_unicode_escape(&p, &u)) != PARSE_OK) {
+                            return ret;
+                        }
+                        break;
+                    default:
+                        return PARSE_INVALID_STRING_ESCAPE;
+                }
+                break;
+            default:
+                if ((unsigned char)ch < 0x20) {
+                    return PARSE_INVALID_STRING_CHAR;
+                }
+                return PARSE_INVALID_UTF8;
+        }
+    }
+}
+
+#define STRING_ERROR(ret) do{ c->top = head; return ret; }while(0)
+
+/**
+ * 解码一个字符串，结果留在解析栈上，*str 在下一次 context_push 前有效
+ * 不计时，由调用者打开 PROFILE_STRING
+*/
+int decode_string_raw(context* c, char** str, size_t* len)
+{
+    size_t head = c->top;
+    unsigned u;
+    int ret;
+    const char* p;
+    int validate = !(c->flags & PARSE_FLAG_NO_UTF8_VALIDATION);
+    EXPECT(c, '\"');
+    p = c->json;
+    while(1)
+    {
+        const char* q = scan_string_run(p, validate);
+        if (q != p) {
+            memcpy(context_push(c, q - p), p, q - p);
+            p = q;
+        }
+        char ch = *p++;
+        switch (ch) {
             case '\"':
-                len = c->top - head;
-                set_string(v, (const char*)context_pop(c, len), len);
+                *len = c->top - head;
+                *str = (char*)context_pop(c, *len);
+                PROFILE_COUNT(string_bytes, p - c->json + 1);
                 c->json = p;
                 return PARSE_OK;
-            case '\0':
-                STRING_ERROR(PARSE_MISS_QUOTATION_MARK);
-            case '\\':
-                switch(*p++) {
-                    case '\"': PUTC(c, '\"'); break;
-                    case '\\': PUTC(c,'\\');  break;
-                    case '/':  PUTC(c,'/');   break;
-                    case 'b':  PUTC(c,'b');   break;
-                    case 'f':  PUTC(c,'f');   break;
-                    case 'n':  PUTC(c,'n');   break;
-                    case 'r':  PUTC(c,'r');   break;
-                    case 't':  PUTC(c,'t');   break;
-                    case 'u':
-                        if (!(p = parse_hex4(p, &u))) {
-                            STRING_ERROR(PARSE_INVALID_UNICODE_HEX);
-                        }
-                        if (u >= 0xD800 && u <= 0xDBFF) {
-                            if (*p++ != '\\') {
-                                STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
-                            }
-                            if (*p++ != 'u') {
-                                STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
-                            }
-                            if (!(p = parse_hex4(p, &u2))) {
-                                STRING_ERROR(PARSE_INVALID_UNICODE_HEX);
-                            }
-                            if (u2 < 0xDC00 || u2 > 0xDFFF) {
-                                STRING_ERROR(PARSE_INVALID_UNICODE_SURROGATE);
-                            }
-                            u = (((u - 0xD800) << 10) + (u2 -0xDC00) + 0x10000);
-                        }
-                        encode_utf8(c, u);
-                        break;
-                    default:
-                        STRING_ERROR(PARSE_INVALID_STRING_ESCAPE);
+            case '\0':
+                STRING_ERROR(PARSE_MISS_QUOTATION_MARK);
+            case '\\':
+                PROFILE_COUNT(escapes, 1);
+                switch(*p++) {
+                    case '\"': PUTC(c, '\"'); break;
+                    case '\\': PUTC(c,'\\');  break;
+                    case '/':  PUTC(c,'/');   break;
+                    case 'b':  PUTC(c,'\b');  break;
+                    case 'f':  PUTC(c,'\f');  break;
+                    case 'n':  PUTC(c,'\n');  break;
+                    case 'r':  PUTC(c,'\r');  break;
+                    case 't':  PUTC(c,'\t');  break;
+                    case 'u':
+                        if ((ret = parse_unicode_escape(&p, &u)) != PARSE_OK) {
+                            STRING_ERROR(ret);
+                        }
+                        encode_utf8(c, u);
+                        break;
+                    default:
+                        STRING_ERROR(PARSE_INVALID_STRING_ESCAPE);
+                }
+                break;
+
+            default:
+                if ((unsigned char)ch < 0x20) {
+                    STRING_ERROR(PARSE_INVALID_STRING_CHAR);
+                }
+                /* scan_string_run 只会停在无效的UTF-8序列上 */
+                STRING_ERROR(PARSE_INVALID_UTF8);
+        }
+    }
+}
+
+int parse_string_raw(context* c, char** str, size_t* len)
+{
+    PROFILE_SCOPE(PROFILE_STRING);
+    return decode_string_raw(c, str, len);
+}
+
+int parse_string(context* c, json_value* v)
+{
+    int ret;
+    char* s;
+    size_t len;
+    if ((ret = parse_string_raw(c, &s, &len)) == PARSE_OK) {
+        v->s.s = (char*)context_malloc(c, len + 1);
+        if (len > 0) {
+            memcpy(v->s.s, s, len);
+        }
+        v->s.s[len] = '\0';
+        v->s.len = len;
+        v->s.capacity = len;
+        v->type = STRING;
+    }
+    return ret;
+}
+
+int parse_array(context* c, json_value* v)
+{
+    size_t size = 0;
+    int ret;
+    EXPECT(c, '[');
+    c->depth++;
+    if (c->stats && c->depth > c->stats->max_depth) {
+        c->stats->max_depth = c->depth;
+    }
+    parse_whitespace(c);
+    if(*c->json == ']') {
+        c->json++;
+        v->type = ARRAY;
+        v->a.size = v->a.capacity = 0;
+        v->a.e = NULL;
+        c->depth--;
+        return PARSE_OK;
+    }
+    while(1)
+    {
+        json_value e;
+        json_init(&e);
+        if((ret = parse_value(c, &e)) != PARSE_OK){
+            break;
+        }
+        memcpy(context_push(c, sizeof(json_value)), &e, sizeof(json_value));
+        size++;
+        parse_whitespace(c);
+        if (*c->json == ','){
+            c->json++;
+            parse_whitespace(c);
+        }
+        else if (*c->json == ']') {
+            c->json++;
+            v->type = ARRAY;
+            v->a.size = v->a.capacity = size;
+            size *= sizeof(json_value);
+            memcpy(v->a.e = (json_value*)context_malloc(c, size), context_pop(c, size), size);
+            c->depth--;
+            return PARSE_OK;
+        }
+        else 
+        {
+            ret = PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+        }
+    }
+
+    for(size_t i = 0; i < size; i++){
+        json_free_value((json_value*)context_pop(c, sizeof(json_value)), c->alloc);
+    }
+    c->depth--;
+    return ret;
+}
+
+int parse_object(context* c, json_value* v)
+{
+    size_t size = 0;
+    json_member m;
+    int ret;
+    EXPECT(c, '{');
+    c->depth++;
+    if (c->stats && c->depth > c->stats->max_depth) {
+        c->stats->max_depth = c->depth;
+    }
+    parse_whitespace(c);
+    if (*c->json == '}') {
+        c->json++;
+        v->type = OBJECT;
+        v->o.size = v->o.capacity = 0;
+        v->o.m = NULL;
+        c->depth--;
+        return PARSE_OK;
+    }
+    m.k = NULL;
+    while(1)
+    {
+        char* str;
+        json_init(&m.v);
+        if (*c->json != '"') {
+            ret = PARSE_MISS_KEY;
+            break;
+        }
+        if ((ret = parse_string_raw(c, &str, &m.klen)) != PARSE_OK) {
+            break;
+        }
+        m.k = (char*)context_malloc(c, m.klen + 1);
+        if (m.klen > 0) {
+            memcpy(m.k, str, m.klen);
+        }
+        m.k[m.klen] = '\0';
+        parse_whitespace(c);
+        if (*c->json != ':') {
+            ret = PARSE_MISS_COLON;
+            break;
+        }
+        c->json++;
+        parse_whitespace(c);
+        if ((ret = parse_value(c, &m.v)) != PARSE_OK) {
+            break;
+        }
+        memcpy(context_push(c, sizeof(json_member)), &m, sizeof(json_member));
+        size++;
+        m.k = NULL; /* 所有权已转移到栈上 */
+        parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            parse_whitespace(c);
+        }
+        else if (*c->json == '}') {
+            c->json++;
+            v->type = OBJECT;
+            v->o.size = v->o.capacity = size;
+            size *= sizeof(json_member);
+            memcpy(v->o.m = (json_member*)context_malloc(c, size), context_pop(c, size), size);
+            c->depth--;
+            return PARSE_OK;
+        }
+        else {
+            ret = PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            break;
+        }
+    }
+
+    if (m.k) {
+        c->alloc->free_fn(c->alloc->user, m.k, m.klen + 1);
+    }
+    for (size_t i = 0; i < size; i++) {
+        json_member* p = (json_member*)context_pop(c, sizeof(json_member));
+        c->alloc->free_fn(c->alloc->user, p->k, p->klen + 1);
+        json_free_value(&p->v, c->alloc);
+    }
+    c->depth--;
+    return ret;
+}
+
+/**
+ * 跳过一个值，只检查语法，不建立任何节点，也不使用解析栈
+*/
+int parse_skip_value(context* c)
+{
+    json_value tmp;
+    int ret;
+    switch (*c->json) {
+        case 't': return parse_literal(c, &tmp, "true", TRUE);
+        case 'f': return parse_literal(c, &tmp, "false", FALSE);
+        case 'n': return parse_literal(c, &tmp, "null", JSON_NULL);
+        case '"': return parse_string_skip(c);
+        case '\0': return PARSE_EXPCET_VALUE;
+        case '[':
+            c->json++;
+            parse_whitespace(c);
+            if (*c->json == ']') {
+                c->json++;
+                return PARSE_OK;
+            }
+            while (1) {
+                if ((ret = parse_skip_value(c)) != PARSE_OK) {
+                    return ret;
                 }
-                break;
-
-            default:
-                if ((unsigned char)ch < 0x20) {
-                    STRING_ERROR(PARSE_INVALID_STRING_CHAR);
+                parse_whitespace(c);
+                if (*c->json == ',') {
+                    c->json++;
+                    parse_whitespace(c);
                 }
-                PUTC(c,ch);
-        }
+                else if (*c->json == ']') {
+                    c->json++;
+                    return PARSE_OK;
+                }
+                else {
+                    return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                }
+            }
+        case '{':
+            c->json++;
+            parse_whitespace(c);
+            if (*c->json == '}') {
+                c->json++;
+                return PARSE_OK;
+            }
+            while (1) {
+                if (*c->json != '"') {
+                    return PARSE_MISS_KEY;
+                }
+                if ((ret = parse_string_skip(c)) != PARSE_OK) {
+                    return ret;
+                }
+                parse_whitespace(c);
+                if (*c->json != ':') {
+                    return PARSE_MISS_COLON;
+                }
+                c->json++;
+                parse_whitespace(c);
+                if ((ret = parse_skip_value(c)) != PARSE_OK) {
+                    return ret;
+                }
+                parse_whitespace(c);
+                if (*c->json == ',') {
+                    c->json++;
+                    parse_whitespace(c);
+                }
+                else if (*c->json == '}') {
+                    c->json++;
+                    return PARSE_OK;
+                }
+                else {
+                    return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                }
+            }
+        default: return parse_number(c, &tmp);
     }
 }
 
-int parse_array(context* c, json_value* v)
+/**
+ * 把字符串写进 v，原缓冲区够大就直接覆盖
+*/
+void reparse_assign_string(context* c, json_value* v, const char* s, size_t len)
+{
+    if (v->type != STRING || v->s.capacity < len) {
+        json_free_value(v, c->alloc);
+        v->s.s = (char*)context_malloc(c, len + 1);
+        v->s.capacity = len;
+        v->type = STRING;
+    }
+    if (len > 0) {
+        memcpy(v->s.s, s, len);
+    }
+    v->s.s[len] = '\0';
+    v->s.len = len;
+}
+
+/**
+ * 解码一个字符串，没有转义时直接指向输入，不经过解析栈
+ * *str 在下一次 context_push 前有效
+*/
+int reparse_string_raw(context* c, const char** str, size_t* len)
+{
+    const char* p = c->json + 1;
+    const char* q;
+    char* s;
+    int ret;
+    PROFILE_SCOPE(PROFILE_STRING);
+    q = scan_string_run(p, !(c->flags & PARSE_FLAG_NO_UTF8_VALIDATION));
+    if (*q == '"') {
+        *str = p;
+        *len = q - p;
+        PROFILE_COUNT(string_bytes, *len + 2);
+        c->json = q + 1;
+        return PARSE_OK;
+    }
+    /* 有转义或错误时退回完整解码，仍计在同一个 PROFILE_STRING 里 */
+    if ((ret = decode_string_raw(c, &s, len)) == PARSE_OK) {
+        *str = s;
+    }
+    return ret;
+}
+
+int reparse_string(context* c, json_value* v)
+{
+    const char* s;
+    size_t len;
+    int ret;
+    if ((ret = reparse_string_raw(c, &s, &len)) == PARSE_OK) {
+        reparse_assign_string(c, v, s, len);
+    }
+    return ret;
+}
+
+int reparse_value(context* c, json_value* v);
+
+/**
+ * 逐个元素就地重新解析；任何时刻 [0, size) 内的元素都是完整的，出错时整棵树可以直接释放
+*/
+int reparse_array(context* c, json_value* v)
 {
     size_t size = 0;
     int ret;
     EXPECT(c, '[');
-    parse_whitespace(c);
-    if(*c->json == ']') {
-        c->json++;
+    c->depth++;
+    if (c->stats && c->depth > c->stats->max_depth) {
+        c->stats->max_depth = c->depth;
+    }
+    if (v->type != ARRAY) {
+        json_free_value(v, c->alloc);
         v->type = ARRAY;
-        v->a.size = 0;
+        v->a.size = v->a.capacity = 0;
         v->a.e = NULL;
-        return PARSE_OK;
     }
-    while(1)
-    {
-        json_value e;
-        json_init(&e);
-        if((ret = parse_value(c, &e)) != PARSE_OK){
+    parse_whitespace(c);
+    if (*c->json == ']') {
+        c->json++;
+    }
+    else while (1) {
+        if (size == v->a.size) {
+            if (size == v->a.capacity) {
+                size_t capacity = v->a.capacity == 0 ? 1 : v->a.capacity * 2;
+                v->a.e = (json_value*)(v->a.e == NULL
+                    ? context_malloc(c, capacity * sizeof(json_value))
+                    : context_realloc(c, v->a.e, v->a.capacity * sizeof(json_value), capacity * sizeof(json_value)));
+                v->a.capacity = capacity;
+            }
+            json_init(&v->a.e[v->a.size++]);
+        }
+        if ((ret = reparse_value(c, &v->a.e[size])) != PARSE_OK) {
+            c->depth--;
+            return ret;
+        }
+        size++;
+        parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            parse_whitespace(c);
+        }
+        else if (*c->json == ']') {
+            c->json++;
             break;
         }
-        memcpy(context_push(c, sizeof(json_value)), &e, sizeof(json_value));
+        else {
+            c->depth--;
+            return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+        }
+    }
+    for (size_t i = size; i < v->a.size; i++) {
+        json_free_value(&v->a.e[i], c->alloc);
+    }
+    v->a.size = size;
+    c->depth--;
+    return PARSE_OK;
+}
+
+/**
+ * 同一位置的键相同时保留原来的键，值就地重新解析
+*/
+int reparse_object(context* c, json_value* v)
+{
+    size_t size = 0;
+    int ret;
+    EXPECT(c, '{');
+    c->depth++;
+    if (c->stats && c->depth > c->stats->max_depth) {
+        c->stats->max_depth = c->depth;
+    }
+    if (v->type != OBJECT) {
+        json_free_value(v, c->alloc);
+        v->type = OBJECT;
+        v->o.size = v->o.capacity = 0;
+        v->o.m = NULL;
+    }
+    parse_whitespace(c);
+    if (*c->json == '}') {
+        c->json++;
+    }
+    else while (1) {
+        const char* key;
+        size_t klen;
+        json_member* m;
+        if (*c->json != '"') {
+            c->depth--;
+            return PARSE_MISS_KEY;
+        }
+        if ((ret = reparse_string_raw(c, &key, &klen)) != PARSE_OK) {
+            c->depth--;
+            return ret;
+        }
+        if (size < v->o.size) {
+            m = &v->o.m[size];
+            if (m->klen != klen || memcmp(m->k, key, klen) != 0) {
+                c->alloc->free_fn(c->alloc->user, m->k, m->klen + 1);
+                m->k = (char*)context_malloc(c, klen + 1);
+                if (klen > 0) {
+                    memcpy(m->k, key, klen);
+                }
+                m->k[klen] = '\0';
+                m->klen = klen;
+            }
+        }
+        else {
+            if (size == v->o.capacity) {
+                size_t capacity = v->o.capacity == 0 ? 1 : v->o.capacity * 2;
+                v->o.m = (json_member*)(v->o.m == NULL
+                    ? context_malloc(c, capacity * sizeof(json_member))
+                    : context_realloc(c, v->o.m, v->o.capacity * sizeof(json_member), capacity * sizeof(json_member)));
+                v->o.capacity = capacity;
+            }
+            m = &v->o.m[v->o.size++];
+            m->k = (char*)context_malloc(c, klen + 1);
+            if (klen > 0) {
+                memcpy(m->k, key, klen);
+            }
+            m->k[klen] = '\0';
+            m->klen = klen;
+            json_init(&m->v);
+        }
+        parse_whitespace(c);
+        if (*c->json != ':') {
+            c->depth--;
+            return PARSE_MISS_COLON;
+        }
+        c->json++;
+        parse_whitespace(c);
+        if ((ret = reparse_value(c, &m->v)) != PARSE_OK) {
+            c->depth--;
+            return ret;
+        }
         size++;
         parse_whitespace(c);
-        if (*c->json == ','){
+        if (*c->json == ',') {
+            c->json++;
+            parse_whitespace(c);
+        }
+        else if (*c->json == '}') {
+            c->json++;
+            break;
+        }
+        else {
+            c->depth--;
+            return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+    }
+    for (size_t i = size; i < v->o.size; i++) {
+        c->alloc->free_fn(c->alloc->user, v->o.m[i].k, v->o.m[i].klen + 1);
+        json_free_value(&v->o.m[i].v, c->alloc);
+    }
+    v->o.size = size;
+    c->depth--;
+    return PARSE_OK;
+}
+
+int reparse_value(context* c, json_value* v)
+{
+    switch (*c->json) {
+        case '"': return reparse_string(c, v);
+        case '[': return reparse_array(c, v);
+        case '{': return reparse_object(c, v);
+        default:
+            json_free_value(v, c->alloc);
+            return parse_value(c, v);
+    }
+}
+
+int reparse(json_value *v, const char *json)
+{
+    return reparse_with_options(v, json, NULL);
+}
+
+int reparse_with_options(json_value *v, const char *json, const parse_options *opt)
+{
+    context c;
+    int ret;
+    assert(v != NULL);
+    context_init(&c, json, opt);
+    parse_whitespace(&c);
+    if ((ret = reparse_value(&c, v)) == PARSE_OK) {
+        parse_whitespace(&c);
+        if (*c.json != '\0') {
+            ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+    if (ret != PARSE_OK) {
+        json_free_value(v, c.alloc);
+    }
+    PROFILE_COUNT(input_bytes, c.json - json);
+    context_release(&c);
+    return ret;
+}
+
+#ifndef REFORMAT_BUFFER_SIZE
+#define REFORMAT_BUFFER_SIZE 4096
+#endif
+
+typedef struct {
+    context c;
+    json_sink sink;
+    void* user;
+    int indent;
+    size_t len;
+    char buf[REFORMAT_BUFFER_SIZE];
+}reformatter;
+
+void reformat_flush(reformatter* r)
+{
+    if (r->len > 0) {
+        r->sink(r->user, r->buf, r->len);
+        r->len = 0;
+    }
+}
+
+void reformat_write(reformatter* r, const char* s, size_t len)
+{
+    if (r->len + len > REFORMAT_BUFFER_SIZE) {
+        reformat_flush(r);
+        if (len > REFORMAT_BUFFER_SIZE) {
+            r->sink(r->user, s, len);  /* 超长的记号直接交给 sink */
+            return;
+        }
+    }
+    memcpy(r->buf + r->len, s, len);
+    r->len += len;
+}
+
+void reformat_putc(reformatter* r, char ch)
+{
+    if (r->len == REFORMAT_BUFFER_SIZE) {
+        reformat_flush(r);
+    }
+    r->buf[r->len++] = ch;
+}
+
+void reformat_newline(reformatter* r, size_t depth)
+{
+    if (r->indent > 0) {
+        reformat_putc(r, '\n');
+        for (size_t i = 0; i < depth * r->indent; i++) {
+            reformat_putc(r, ' ');
+        }
+    }
+}
+
+int reformat_value(reformatter* r, size_t depth);
+
+int reformat_array(reformatter* r, size_t depth)
+{
+    context* c = &r->c;
+    int ret;
+    EXPECT(c, '[');
+    reformat_putc(r, '[');
+    parse_whitespace(c);
+    if (*c->json == ']') {
+        c->json++;
+        reformat_putc(r, ']');
+        return PARSE_OK;
+    }
+    while (1) {
+        reformat_newline(r, depth + 1);
+        if ((ret = reformat_value(r, depth + 1)) != PARSE_OK) {
+            return ret;
+        }
+        parse_whitespace(c);
+        if (*c->json == ',') {
             c->json++;
+            reformat_putc(r, ',');
             parse_whitespace(c);
         }
         else if (*c->json == ']') {
             c->json++;
-            v->type = ARRAY;
-            v->a.size = size;
-            size *= sizeof(json_value);
-            memcpy(v->a.e = (json_value*)malloc(size), context_pop(c, size), size);
+            reformat_newline(r, depth);
+            reformat_putc(r, ']');
             return PARSE_OK;
         }
-        else 
-        {
-            ret = PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-            break;
+        else {
+            return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
         }
     }
+}
 
-    for(size_t i = 0; i < size; i++){
-        json_free((json_value*)context_pop(c, sizeof(json_value)));
+int reformat_object(reformatter* r, size_t depth)
+{
+    context* c = &r->c;
+    const char* start;
+    int ret;
+    EXPECT(c, '{');
+    reformat_putc(r, '{');
+    parse_whitespace(c);
+    if (*c->json == '}') {
+        c->json++;
+        reformat_putc(r, '}');
+        return PARSE_OK;
+    }
+    while (1) {
+        if (*c->json != '"') {
+            return PARSE_MISS_KEY;
+        }
+        reformat_newline(r, depth + 1);
+        start = c->json;
+        if ((ret = parse_string_skip(c)) != PARSE_OK) {
+            return ret;
+        }
+        reformat_write(r, start, c->json - start);
+        parse_whitespace(c);
+        if (*c->json != ':') {
+            return PARSE_MISS_COLON;
+        }
+        c->json++;
+        reformat_putc(r, ':');
+        if (r->indent > 0) {
+            reformat_putc(r, ' ');
+        }
+        parse_whitespace(c);
+        if ((ret = reformat_value(r, depth + 1)) != PARSE_OK) {
+            return ret;
+        }
+        parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            reformat_putc(r, ',');
+            parse_whitespace(c);
+        }
+        else if (*c->json == '}') {
+            c->json++;
+            reformat_newline(r, depth);
+            reformat_putc(r, '}');
+            return PARSE_OK;
+        }
+        else {
+            return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+    }
+}
+
+/**
+ * 字面量、字符串和数字校验通过后把输入中的原文写出
+*/
+int reformat_value(reformatter* r, size_t depth)
+{
+    context* c = &r->c;
+    const char* start = c->json;
+    json_value tmp;
+    int ret;
+    switch (*c->json) {
+        case 't': ret = parse_literal(c, &tmp, "true", TRUE); break;
+        case 'f': ret = parse_literal(c, &tmp, "false", FALSE); break;
+        case 'n': ret = parse_literal(c, &tmp, "null", JSON_NULL); break;
+        case '"': ret = parse_string_skip(c); break;
+        case '[': return reformat_array(r, depth);
+        case '{': return reformat_object(r, depth);
+        case '\0': return PARSE_EXPCET_VALUE;
+        default : ret = parse_number(c, &tmp); break;
+    }
+    if (ret == PARSE_OK) {
+        reformat_write(r, start, c->json - start);
+    }
+    return ret;
+}
+
+int json_reformat(const char* json, int indent, json_sink sink, void* user)
+{
+    reformatter r;
+    int ret;
+    assert(json != NULL && sink != NULL && indent >= 0);
+    context_init(&r.c, json, NULL);
+    r.sink = sink;
+    r.user = user;
+    r.indent = indent;
+    r.len = 0;
+    parse_whitespace(&r.c);
+    if ((ret = reformat_value(&r, 0)) == PARSE_OK) {
+        parse_whitespace(&r.c);
+        if (*r.c.json != '\0') {
+            ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+        else {
+            reformat_flush(&r);
+        }
     }
+    PROFILE_COUNT(input_bytes, r.c.json - json);
+    context_release(&r.c);
     return ret;
 }
+
+typedef struct {
+    char* s;
+    size_t len, capacity;
+}string_buffer;
+
+void string_buffer_sink(void* user, const char* data, size_t len)
+{
+    string_buffer* b = (string_buffer*)user;
+    if (b->len + len + 1 > b->capacity) {
+        while (b->len + len + 1 > b->capacity) {
+            b->capacity += b->capacity >> 1;
+        }
+        b->s = (char*)realloc(b->s, b->capacity);
+    }
+    memcpy(b->s + b->len, data, len);
+    b->len += len;
+}
+
+int json_reformat_string(const char* json, int indent, char** out, size_t* length)
+{
+    string_buffer b;
+    int ret;
+    assert(out != NULL);
+    b.capacity = PARSE_STACK_INIT_SIZE;
+    b.len = 0;
+    b.s = (char*)malloc(b.capacity);
+    if ((ret = json_reformat(json, indent, string_buffer_sink, &b)) != PARSE_OK) {
+        free(b.s);
+        *out = NULL;
+        return ret;
+    }
+    b.s[b.len] = '\0';
+    *out = b.s;
+    if (length) {
+        *length = b.len;
+    }
+    return PARSE_OK;
+}
+
+#ifdef JSON_PROFILE
+void json_profile_reset(void)
+{
+    memset(&profile_data, 0, sizeof(profile_data));
+}
+
+const json_profile* json_profile_get(void)
+{
+    return &profile_data;
+}
+
+void json_profile_dump(FILE* out, const char* title)
+{
+    static const char* phases[PROFILE_PHASE_COUNT] = {
+        "whitespace", "string", "number", "  strtod", "stack grow", "json_free"
+    };
+    const json_profile* p = &profile_data;
+    size_t tokens = p->whitespace_bytes + p->literal_bytes + p->number_bytes + p->string_bytes;
+    fprintf(out, "== %s ==\n", title ? title : "json profile");
+    fprintf(out, "bytes      total %zu  whitespace %zu  literal %zu  number %zu  string %zu  structural %zu\n",
+            p->input_bytes, p->whitespace_bytes, p->literal_bytes, p->number_bytes, p->string_bytes,
+            p->input_bytes > tokens ? p->input_bytes - tokens : 0);
+    fprintf(out, "escapes    %zu  \\u %zu  surrogate pairs %zu\n", p->escapes, p->unicode_escapes, p->surrogate_pairs);
+    fprintf(out, "stack      %zu reallocs\n", p->stack_reallocs);
+    fprintf(out, "%-12s %12s %16s %12s\n", "phase", "calls", "cycles", "cycles/call");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        fprintf(out, "%-12s %12zu %16llu %12.1f\n", phases[i], p->calls[i], (unsigned long long)p->cycles[i],
+                p->calls[i] ? (double)p->cycles[i] / p->calls[i] : 0.0);
+    }
+}
+#endif
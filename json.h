@@ -29,9 +29,9 @@ struct json_value {
     union 
     {
         double n;  /* number */
-        struct { char* s; int len; } s; /* string */
-        struct { json_value* e; size_t size; }a; /* array */
-        struct { json_member* m; size_t size; }o; 
+        struct { char* s; int len; size_t capacity; } s; /* string，capacity 不含结尾的'\0' */
+        struct { json_value* e; size_t size, capacity; }a; /* array */
+        struct { json_member* m; size_t size, capacity; }o; /* object */
     };
 };
 
@@ -51,39 +51,202 @@ enum{
     PARSE_INVALID_STRING_CHAR, // 解析无效的字符串字符
     PARSE_INVALID_UNICODE_HEX, // 解析无效的unicode十六进制
     PARSE_INVALID_UNICODE_SURROGATE, // 解析无效的unicode代理
-    PARSE_MISS_COMMA_OR_SQUARE_BRACKET // 解析逗号或方括号
+    PARSE_MISS_COMMA_OR_SQUARE_BRACKET, // 解析逗号或方括号
+    PARSE_INVALID_UTF8, // 字符串中含无效的UTF-8字节序列
+    PARSE_MISS_KEY, // 缺少对象的键
+    PARSE_MISS_COLON, // 缺少冒号
+    PARSE_MISS_COMMA_OR_CURLY_BRACKET, // 缺少逗号或花括号
+    PARSE_TYPE_MISMATCH // 绑定到C++类型时类型不符
 };
 
+enum{
+    PARSE_FLAG_DEFAULT = 0,
+    PARSE_FLAG_NO_UTF8_VALIDATION = 1 << 0 // 跳过UTF-8校验，仅用于可信输入
+};
+
+#define KEY_NOT_EXIST ((size_t)-1)
+
+/**
+ * 可替换的内存分配器，user 原样传回给每个回调
+ * realloc/free 会带上原大小，方便按大小分级的内存池
+ * 用自定义分配器建立的树，修改和释放都要用对应的 *_with 接口并传入同一个分配器；
+ * 不带 _with 的接口等价于传入 json_default_allocator
+*/
+typedef struct {
+    void* (*malloc_fn)(void* user, size_t size);
+    void* (*realloc_fn)(void* user, void* ptr, size_t old_size, size_t new_size);
+    void  (*free_fn)(void* user, void* ptr, size_t size);
+    void* user;
+}json_allocator;
+
+extern const json_allocator json_default_allocator; // malloc/realloc/free
+
+/* 单次解析的统计，每次解析开始时清零 */
+typedef struct {
+    size_t alloc_count; // 分配次数(含realloc)
+    size_t alloc_bytes; // 分配的总字节数
+    size_t peak_stack_size; // 解析栈的峰值大小
+    size_t max_depth; // 最大嵌套深度
+}parse_stats;
+
+typedef struct {
+    unsigned flags; // PARSE_FLAG_*
+    const json_allocator* allocator; // NULL 表示默认分配器
+    parse_stats* stats; // NULL 表示不统计
+}parse_options;
+
 typedef struct {
     const char* json;
     char* stack;
     size_t size, top;
+    unsigned flags;
+    const json_allocator* alloc;
+    parse_stats* stats;
+    size_t depth;
 }context;
 
 
 
 void set_number(json_value *v, double n);
+void set_number_with(json_value *v, double n, const json_allocator* alloc);
 double get_number(const json_value *value);
 
 void set_boolean(json_value *v, int n);
+void set_boolean_with(json_value *v, int n, const json_allocator* alloc);
 int get_boolean(const json_value *v);
 
 void set_string(json_value *v, const char* s, size_t len);
+void set_string_with(json_value *v, const char* s, size_t len, const json_allocator* alloc);
 size_t get_string_length(const json_value *v); // 返回string的长度
 const char* get_string(const json_value *v); // 返回string
 
 json_type get_value(const json_value *value);
+
+void set_array(json_value* v, size_t capacity);
+void set_array_with(json_value* v, size_t capacity, const json_allocator* alloc);
 size_t get_array_size(const json_value* v);
+size_t get_array_capacity(const json_value* v);
+void reserve_array(json_value* v, size_t capacity);
+void reserve_array_with(json_value* v, size_t capacity, const json_allocator* alloc);
+void shrink_array(json_value* v);
+void shrink_array_with(json_value* v, const json_allocator* alloc);
+void clear_array(json_value* v);
+void clear_array_with(json_value* v, const json_allocator* alloc);
 json_value* get_array_element(const json_value* v, size_t index);
-
+json_value* pushback_array_element(json_value* v); // 返回新元素(null)，均摊O(1)
+json_value* pushback_array_element_with(json_value* v, const json_allocator* alloc);
+void popback_array_element(json_value* v);
+void popback_array_element_with(json_value* v, const json_allocator* alloc);
+json_value* insert_array_element(json_value* v, size_t index);
+json_value* insert_array_element_with(json_value* v, size_t index, const json_allocator* alloc);
+void erase_array_element(json_value* v, size_t index, size_t count);
+void erase_array_element_with(json_value* v, size_t index, size_t count, const json_allocator* alloc);
+
+void set_object(json_value* v, size_t capacity);
+void set_object_with(json_value* v, size_t capacity, const json_allocator* alloc);
 size_t get_object_size(const json_value* v);
+size_t get_object_capacity(const json_value* v);
+void reserve_object(json_value* v, size_t capacity);
+void reserve_object_with(json_value* v, size_t capacity, const json_allocator* alloc);
+void shrink_object(json_value* v);
+void shrink_object_with(json_value* v, const json_allocator* alloc);
+void clear_object(json_value* v);
+void clear_object_with(json_value* v, const json_allocator* alloc);
 const char* get_object_key(const json_value* v, size_t index);
 size_t get_object_key_length(const json_value* v, size_t index);
 json_value* get_object_value(const json_value* v, size_t index);
+size_t find_object_index(const json_value* v, const char* key, size_t klen); // 找不到返回 KEY_NOT_EXIST
+json_value* find_object_value(const json_value* v, const char* key, size_t klen);
+json_value* set_object_value(json_value* v, const char* key, size_t klen); // 不存在则追加
+json_value* set_object_value_with(json_value* v, const char* key, size_t klen, const json_allocator* alloc);
+json_value* pushback_object_member(json_value* v, const char* key, size_t klen); // 不查重直接追加
+json_value* pushback_object_member_with(json_value* v, const char* key, size_t klen, const json_allocator* alloc);
+void popback_object_member(json_value* v);
+void popback_object_member_with(json_value* v, const json_allocator* alloc);
+json_value* insert_object_member(json_value* v, size_t index, const char* key, size_t klen); // 不查重，插入到index处
+json_value* insert_object_member_with(json_value* v, size_t index, const char* key, size_t klen, const json_allocator* alloc);
+void erase_object_member(json_value* v, size_t index, size_t count);
+void erase_object_member_with(json_value* v, size_t index, size_t count, const json_allocator* alloc);
+void remove_object_value(json_value* v, size_t index);
+void remove_object_value_with(json_value* v, size_t index, const json_allocator* alloc);
 
 
 void json_free(json_value *v);
+void json_free_with(json_value *v, const json_allocator *alloc);
+void json_copy(json_value *dst, const json_value *src); // 深拷贝，每个节点按大小一次分配
+void json_copy_with(json_value *dst, const json_value *src, const json_allocator *alloc);
+void json_move(json_value *dst, json_value *src); // 转移所有权，src 变为 null，dst 原有内容按默认分配器释放
+void json_move_with(json_value *dst, json_value *src, const json_allocator *alloc); // dst 原有内容按 alloc 释放
+void json_swap(json_value *lhs, json_value *rhs);
+int json_equal(const json_value *lhs, const json_value *rhs); // 结构相等，对象成员与顺序无关
+size_t json_hash(const json_value *v); // 与 json_equal 一致：相等的值哈希相同
 int parse(json_value *v, const char *json);
+int parse_with_flags(json_value *v, const char *json, unsigned flags);
+int parse_with_options(json_value *v, const char *json, const parse_options *opt);
+/**
+ * 把新输入解析进已有的树，类型相同且容量足够时复用原有的字符串和数组内存
+ * 结构不变的消息反复解析时几乎不再分配；出错时 v 被释放为 null
+*/
+int reparse(json_value *v, const char *json);
+int reparse_with_options(json_value *v, const char *json, const parse_options *opt);
+
+/* 直接在输入上工作的底层接口，供 json_bind.hpp 使用 */
+void context_init(context* c, const char* json, const parse_options* opt);
+void context_release(context* c);
+void parse_whitespace(context* c);
+int parse_number(context *c, json_value *v);
+int parse_int64(context* c, long long* out); // 整数按整数读取，小数、指数或越界返回 PARSE_TYPE_MISMATCH
+int parse_uint64(context* c, unsigned long long* out);
+int parse_literal(context *c, json_value *v, const char* literal, json_type type);
+int parse_string_raw(context* c, char** str, size_t* len);
+int parse_string_skip(context* c);
+int parse_skip_value(context* c);
+
+/**
+ * 不建树的流式重排：按原语法走一遍输入，字符串和数字原样拷贝
+ * indent 为 0 时压缩输出，大于 0 时每层缩进 indent 个空格
+ * 输出先写入固定大小的缓冲区，满了才交给 sink，出错时 sink 可能已收到部分输出
+*/
+typedef void (*json_sink)(void* user, const char* data, size_t len);
+int json_reformat(const char* json, int indent, json_sink sink, void* user);
+int json_reformat_string(const char* json, int indent, char** out, size_t* length); // *out 由调用者 free
+
+#ifdef JSON_PROFILE
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * 插桩构建(cmake -DJSON_PROFILE=ON)才有的热点统计，按线程累计直到 json_profile_reset
+ * 各阶段的周期数包含其内部调用，例如 STRING 包含其中的解析栈扩容
+*/
+enum {
+    PROFILE_WHITESPACE,
+    PROFILE_STRING,
+    PROFILE_NUMBER, // 含 strtod
+    PROFILE_STRTOD,
+    PROFILE_STACK_GROW, // context_push 扩容
+    PROFILE_FREE, // 公开的 json_free/json_free_with 调用，不含库内部的节点重置
+    PROFILE_PHASE_COUNT
+};
+
+typedef struct {
+    size_t input_bytes; // parse/reparse/json_reformat 消费的总字节
+    size_t whitespace_bytes;
+    size_t literal_bytes;
+    size_t number_bytes;
+    size_t string_bytes; // 含引号
+    size_t escapes; // 反斜杠转义总数
+    size_t unicode_escapes; // 其中的 \uXXXX
+    size_t surrogate_pairs;
+    size_t stack_reallocs;
+    uint64_t cycles[PROFILE_PHASE_COUNT]; // x86 上为TSC周期，其他平台为 steady_clock 计数
+    size_t calls[PROFILE_PHASE_COUNT];
+}json_profile;
+
+void json_profile_reset(void);
+const json_profile* json_profile_get(void);
+void json_profile_dump(FILE* out, const char* title);
+#endif
 
 
 
@@ -0,0 +1,124 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include "json.h"
+#include <utility>
+#include <functional>
+
+/**
+ * json_value 的C++11封装
+ * 只能移动不能隐式拷贝，析构时调用 json_free；需要副本时显式调用 clone()
+ * 可以指定分配器，树的分配和释放都走同一个分配器
+ * 修改树中的节点时用 *_with 接口并传入 allocator()，不要混用默认分配器的版本
+*/
+namespace json {
+
+class Value {
+public:
+    explicit Value(const json_allocator* alloc = &json_default_allocator) : alloc_(alloc) { json_init(&v_); }
+    ~Value() { json_free_with(&v_, alloc_); }
+
+    Value(Value&& other) noexcept : alloc_(other.alloc_) { json_init(&v_); json_move_with(&v_, &other.v_, alloc_); }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            json_free_with(&v_, alloc_);
+            alloc_ = other.alloc_;
+            json_move_with(&v_, &other.v_, alloc_);
+        }
+        return *this;
+    }
+
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    /* 接管一个已有的 json_value，raw 变为 null */
+    static Value adopt(json_value* raw, const json_allocator* alloc = &json_default_allocator) {
+        Value ret(alloc);
+        json_move_with(&ret.v_, raw, alloc);
+        return ret;
+    }
+
+    Value clone() const {
+        Value ret(alloc_);
+        json_copy_with(&ret.v_, &v_, alloc_);
+        return ret;
+    }
+
+    void swap(Value& other) noexcept {
+        json_swap(&v_, &other.v_);
+        std::swap(alloc_, other.alloc_);
+    }
+
+    /* 交出所有权，调用者负责用 allocator() 释放；out 原有内容也按 allocator() 释放 */
+    void release(json_value* out) { json_move_with(out, &v_, alloc_); }
+
+    json_type type() const { return get_value(&v_); }
+    json_value* get() { return &v_; }
+    const json_value* get() const { return &v_; }
+    const json_allocator* allocator() const { return alloc_; }
+
+private:
+    json_value v_;
+    const json_allocator* alloc_;
+};
+
+class Document : public Value {
+public:
+    explicit Document(const json_allocator* alloc = &json_default_allocator) : Value(alloc), error_(PARSE_OK) {}
+    Document(Document&& other) noexcept : Value(std::move(other)), error_(other.error_) {}
+    Document& operator=(Document&& other) noexcept {
+        Value::operator=(std::move(other));
+        error_ = other.error_;
+        return *this;
+    }
+
+    /* parse 会直接覆盖 v，先释放旧树 */
+    int parse(const char* json, unsigned flags = PARSE_FLAG_DEFAULT, parse_stats* stats = NULL) {
+        parse_options opt = { flags, allocator(), stats };
+        json_free_with(get(), allocator());
+        return error_ = parse_with_options(get(), json, &opt);
+    }
+
+    /* 复用当前树的内存解析结构相同的新消息 */
+    int reparse(const char* json, unsigned flags = PARSE_FLAG_DEFAULT, parse_stats* stats = NULL) {
+        parse_options opt = { flags, allocator(), stats };
+        return error_ = reparse_with_options(get(), json, &opt);
+    }
+
+    int error() const { return error_; }
+    bool ok() const { return error_ == PARSE_OK; }
+
+private:
+    int error_;
+};
+
+inline void swap(Value& lhs, Value& rhs) noexcept { lhs.swap(rhs); }
+
+inline bool operator==(const Value& lhs, const Value& rhs) { return json_equal(lhs.get(), rhs.get()) != 0; }
+inline bool operator!=(const Value& lhs, const Value& rhs) { return !(lhs == rhs); }
+
+/* 供 std::unordered_map<const json_value*, T, json::Hash, json::Equal> 这类以指针为键的容器使用 */
+struct Hash {
+    size_t operator()(const json_value* v) const { return json_hash(v); }
+    size_t operator()(const Value& v) const { return json_hash(v.get()); }
+};
+
+struct Equal {
+    bool operator()(const json_value* lhs, const json_value* rhs) const { return json_equal(lhs, rhs) != 0; }
+    bool operator()(const Value& lhs, const Value& rhs) const { return lhs == rhs; }
+};
+
+} // namespace json
+
+namespace std {
+template <>
+struct hash<json::Value> {
+    size_t operator()(const json::Value& v) const { return json_hash(v.get()); }
+};
+template <>
+struct hash<json::Document> {
+    size_t operator()(const json::Document& v) const { return json_hash(v.get()); }
+};
+}
+
+#endif //JSON_HPP
@@ -0,0 +1,277 @@
+#ifndef JSON_BIND_HPP
+#define JSON_BIND_HPP
+
+#include "json.h"
+#include <string>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <limits>
+#include <cmath>
+
+/**
+ * 把JSON直接解码到C++结构体，不建立中间的 json_value 树
+ * 结构体用 JSON_BIND_BEGIN / JSON_BIND_FIELD / JSON_BIND_END 声明字段：
+ *
+ *     struct point { double x, y; std::string name; std::vector<int> tags; };
+ *     JSON_BIND_BEGIN(point)
+ *         JSON_BIND_FIELD(x)
+ *         JSON_BIND_FIELD(y)
+ *         JSON_BIND_FIELD(name)
+ *         JSON_BIND_FIELD_NAMED(tags, "labels")
+ *     JSON_BIND_END()
+ *
+ *     point p;
+ *     int ret = json::decode(p, "{\"x\":1,\"y\":2,\"name\":\"a\"}");
+ *
+ * 未声明的键直接跳过；值为 null 的字段保持原值；出错时 out 可能只填了一部分
+ * 数值超出字段类型的范围、或把带小数/指数的数字绑定到整数字段时返回 PARSE_TYPE_MISMATCH
+*/
+namespace json {
+
+template <class T, class Enable = void>
+struct binder;
+
+template <class T>
+int bind_read(context* c, T& out);
+
+/**
+ * 类型不符时先确认输入本身是合法的JSON，语法错误优先报告
+*/
+inline int bind_mismatch(context* c)
+{
+    int ret = parse_skip_value(c);
+    return ret != PARSE_OK ? ret : PARSE_TYPE_MISMATCH;
+}
+
+template <>
+struct binder<bool> {
+    static int read(context* c, bool& out) {
+        json_value tmp;
+        int ret;
+        switch (*c->json) {
+            case 't': ret = parse_literal(c, &tmp, "true", TRUE); break;
+            case 'f': ret = parse_literal(c, &tmp, "false", FALSE); break;
+            default: return bind_mismatch(c);
+        }
+        if (ret == PARSE_OK) {
+            out = tmp.type == TRUE;
+        }
+        return ret;
+    }
+};
+
+/**
+ * 整数字段按64位整数读取，不经过 double；再检查是否落在字段类型的 [min, max] 内
+*/
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type bind_read_number(context* c, T& out)
+{
+    long long n;
+    int ret;
+    if ((ret = parse_int64(c, &n)) != PARSE_OK) {
+        return ret;
+    }
+    if (n < static_cast<long long>(std::numeric_limits<T>::min()) || n > static_cast<long long>(std::numeric_limits<T>::max())) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    out = static_cast<T>(n);
+    return PARSE_OK;
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, int>::type bind_read_number(context* c, T& out)
+{
+    unsigned long long n;
+    int ret;
+    if ((ret = parse_uint64(c, &n)) != PARSE_OK) {
+        return ret;
+    }
+    if (n > static_cast<unsigned long long>(std::numeric_limits<T>::max())) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    out = static_cast<T>(n);
+    return PARSE_OK;
+}
+
+/* 浮点字段只检查溢出 */
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value, int>::type bind_read_number(context* c, T& out)
+{
+    json_value tmp;
+    int ret;
+    if ((ret = parse_number(c, &tmp)) != PARSE_OK) {
+        return ret;
+    }
+    if (std::fabs(tmp.n) > static_cast<double>(std::numeric_limits<T>::max())) {
+        return PARSE_TYPE_MISMATCH;
+    }
+    out = static_cast<T>(tmp.n);
+    return PARSE_OK;
+}
+
+template <class T>
+struct binder<T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type> {
+    static int read(context* c, T& out) {
+        if (*c->json != '-' && !(*c->json >= '0' && *c->json <= '9')) {
+            return bind_mismatch(c);
+        }
+        return bind_read_number(c, out);
+    }
+};
+
+template <>
+struct binder<std::string> {
+    static int read(context* c, std::string& out) {
+        char* s;
+        size_t len;
+        int ret;
+        if (*c->json != '"') {
+            return bind_mismatch(c);
+        }
+        if ((ret = parse_string_raw(c, &s, &len)) == PARSE_OK) {
+            out.assign(s, len);
+        }
+        return ret;
+    }
+};
+
+template <class T>
+struct binder<std::vector<T> > {
+    static int read(context* c, std::vector<T>& out) {
+        int ret;
+        if (*c->json != '[') {
+            return bind_mismatch(c);
+        }
+        c->json++;
+        out.clear();
+        parse_whitespace(c);
+        if (*c->json == ']') {
+            c->json++;
+            return PARSE_OK;
+        }
+        while (1) {
+            T e = T();
+            if ((ret = bind_read(c, e)) != PARSE_OK) {
+                return ret;
+            }
+            out.push_back(std::move(e));
+            parse_whitespace(c);
+            if (*c->json == ',') {
+                c->json++;
+                parse_whitespace(c);
+            }
+            else if (*c->json == ']') {
+                c->json++;
+                return PARSE_OK;
+            }
+            else {
+                return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            }
+        }
+    }
+};
+
+/**
+ * 读入一个对象，每个键交给 binder<T>::field 分派
+ * 键只在解析栈上解码，分派完成前栈不会再被写入
+*/
+template <class T>
+int bind_read_object(context* c, T& out)
+{
+    char* key;
+    size_t klen;
+    int ret;
+    if (*c->json != '{') {
+        return bind_mismatch(c);
+    }
+    c->json++;
+    parse_whitespace(c);
+    if (*c->json == '}') {
+        c->json++;
+        return PARSE_OK;
+    }
+    while (1) {
+        if (*c->json != '"') {
+            return PARSE_MISS_KEY;
+        }
+        if ((ret = parse_string_raw(c, &key, &klen)) != PARSE_OK) {
+            return ret;
+        }
+        parse_whitespace(c);
+        if (*c->json != ':') {
+            return PARSE_MISS_COLON;
+        }
+        c->json++;
+        parse_whitespace(c);
+        if ((ret = binder<T>::field(c, out, key, klen)) != PARSE_OK) {
+            return ret;
+        }
+        parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            parse_whitespace(c);
+        }
+        else if (*c->json == '}') {
+            c->json++;
+            return PARSE_OK;
+        }
+        else {
+            return PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+    }
+}
+
+template <class T>
+int bind_read(context* c, T& out)
+{
+    if (*c->json == 'n') {
+        json_value tmp;
+        return parse_literal(c, &tmp, "null", JSON_NULL);
+    }
+    return binder<T>::read(c, out);
+}
+
+template <class T>
+int decode(T& out, const char* json, const parse_options* opt = NULL)
+{
+    context c;
+    int ret;
+    context_init(&c, json, opt);
+    parse_whitespace(&c);
+    if ((ret = bind_read(&c, out)) == PARSE_OK) {
+        parse_whitespace(&c);
+        if (*c.json != '\0') {
+            ret = PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+    context_release(&c);
+    return ret;
+}
+
+} // namespace json
+
+#define JSON_BIND_BEGIN(Type)                                                   \
+    namespace json {                                                            \
+    template <>                                                                 \
+    struct binder<Type> {                                                       \
+        static int read(context* c, Type& out) {                                \
+            return bind_read_object(c, out);                                    \
+        }                                                                       \
+        static int field(context* c, Type& out, const char* key, size_t klen) { \
+            (void)out;
+
+#define JSON_BIND_FIELD_NAMED(member, name)                                     \
+            if (klen == sizeof(name) - 1 && memcmp(key, name, klen) == 0) {     \
+                return bind_read(c, out.member);                                \
+            }
+
+#define JSON_BIND_FIELD(member) JSON_BIND_FIELD_NAMED(member, #member)
+
+#define JSON_BIND_END()                                                         \
+            return parse_skip_value(c);                                         \
+        }                                                                       \
+    };                                                                          \
+    }
+
+#endif //JSON_BIND_HPP
@@ -4,9 +4,43 @@
 #endif
 
 #include "json.h"
+#include "json.hpp"
+#include "json_bind.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <limits>
+
+struct bind_point {
+    double x, y;
+};
+
+struct bind_record {
+    int id;
+    std::string name;
+    bool active;
+    std::vector<bind_point> path;
+    std::vector<std::string> tags;
+    unsigned flags;
+};
+
+JSON_BIND_BEGIN(bind_point)
+    JSON_BIND_FIELD(x)
+    JSON_BIND_FIELD(y)
+JSON_BIND_END()
+
+JSON_BIND_BEGIN(bind_record)
+    JSON_BIND_FIELD(id)
+    JSON_BIND_FIELD(name)
+    JSON_BIND_FIELD(active)
+    JSON_BIND_FIELD(path)
+    JSON_BIND_FIELD(tags)
+    JSON_BIND_FIELD_NAMED(flags, "flag_bits")
+JSON_BIND_END()
 
 int main_ret = 0;
 int test_count = 0;
@@ -122,6 +156,9 @@ void parse_string() {
     TEST_STRING("\xE2\x82\xAC", "\"\\u20AC\""); /* Euro sign U+20AC */
     TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\"");  /* G clef sign U+1D11E */
     TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");  /* G clef sign U+1D11E */
+    TEST_STRING("\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E", "\"\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E\""); /* raw UTF-8 */
+    TEST_STRING("0123456789abcdef0123456789abcdef\xE4\xB8\xAD" "0123456789abcdef",
+                "\"0123456789abcdef0123456789abcdef\xE4\xB8\xAD" "0123456789abcdef\"");
 }
 
 #define TEST_ERROR(error, json)                \
@@ -217,6 +254,48 @@ void test_parse_invalid_unicode_surrogate() {
     TEST_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
 }
 
+void test_parse_invalid_utf8() {
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\x80\"");                 /* unexpected continuation */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xC0\xAF\"");             /* overlong */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xC2\"");                 /* truncated */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xE0\x80\xAF\"");         /* overlong */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");         /* surrogate U+D800 */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\"");     /* > U+10FFFF */
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xF5\x80\x80\x80\"");
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"\xFF\"");
+    TEST_ERROR(PARSE_INVALID_UTF8, "\"0123456789abcdef0123456789abcdef\xE2\x82\"");
+    TEST_ERROR(PARSE_INVALID_UTF8, "[\"a\", \"\xC3\x28\"]");
+
+    /* 各种序列放在16字节块边界附近的每个位置上 */
+    static const char* bad[] = { "\x80", "\xE4\xB8", "\xE0\x9F\xBF", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xC1\xBF" };
+    static const char* good[] = { "\xC3\xA9", "\xE4\xB8\xAD", "\xED\x9F\xBF", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF" };
+    char json[64];
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        for (int k = 0; k < 20; k++) {
+            snprintf(json, sizeof(json), "\"%.*s%s\xE4\xB8\xAD" "abc\"", k, "0123456789abcdef0123", bad[i]);
+            TEST_ERROR(PARSE_INVALID_UTF8, json);
+        }
+    }
+    for (size_t i = 0; i < sizeof(good) / sizeof(good[0]); i++) {
+        for (int k = 0; k < 20; k++) {
+            json_value v;
+            json_init(&v);
+            snprintf(json, sizeof(json), "\"%.*s%s%s\"", k, "0123456789abcdef0123", good[i], good[i]);
+            TEST_AC_INT(PARSE_OK, parse(&v, json));
+            TEST_AC_INT((int)strlen(json) - 2, (int)get_string_length(&v));
+            json_free(&v);
+        }
+    }
+}
+
+void test_parse_no_utf8_validation() {
+    json_value v;
+    json_init(&v);
+    TEST_AC_INT(PARSE_OK, parse_with_flags(&v, "\"\xC0\xAF\"", PARSE_FLAG_NO_UTF8_VALIDATION));
+    TEST_AC_STRING("\xC0\xAF", get_string(&v), get_string_length(&v));
+    json_free(&v);
+}
+
 static void test_parse_miss_comma_or_square_bracket() {
     TEST_ERROR(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1");
     TEST_ERROR(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1}");
@@ -270,6 +349,92 @@ void test_parse_array()
     json_free(&v);
 }
 
+void test_parse_object()
+{
+    size_t i;
+    json_value v;
+
+    json_init(&v);
+    TEST_AC_INT(PARSE_OK, parse(&v, " { } "));
+    TEST_AC_INT(OBJECT, get_value(&v));
+    EXPECT_AC_SIZE_T(0, get_object_size(&v));
+    json_free(&v);
+
+    json_init(&v);
+    TEST_AC_INT(PARSE_OK, parse(&v,
+        " { "
+        "\"n\" : null , "
+        "\"f\" : false , "
+        "\"t\" : true , "
+        "\"i\" : 123 , "
+        "\"s\" : \"abc\", "
+        "\"a\" : [ 1, 2, 3 ],"
+        "\"o\" : { \"1\" : 1, \"2\" : 2, \"3\" : 3 }"
+        " } "
+    ));
+    TEST_AC_INT(OBJECT, get_value(&v));
+    EXPECT_AC_SIZE_T(7, get_object_size(&v));
+    TEST_AC_STRING("n", get_object_key(&v, 0), get_object_key_length(&v, 0));
+    TEST_AC_INT(JSON_NULL, get_value(get_object_value(&v, 0)));
+    TEST_AC_STRING("f", get_object_key(&v, 1), get_object_key_length(&v, 1));
+    TEST_AC_INT(FALSE, get_value(get_object_value(&v, 1)));
+    TEST_AC_STRING("t", get_object_key(&v, 2), get_object_key_length(&v, 2));
+    TEST_AC_INT(TRUE, get_value(get_object_value(&v, 2)));
+    TEST_AC_STRING("i", get_object_key(&v, 3), get_object_key_length(&v, 3));
+    TEST_AC_INT(NUMBER, get_value(get_object_value(&v, 3)));
+    TEST_AC_DOUBLE(123.0, get_number(get_object_value(&v, 3)));
+    TEST_AC_STRING("s", get_object_key(&v, 4), get_object_key_length(&v, 4));
+    TEST_AC_INT(STRING, get_value(get_object_value(&v, 4)));
+    TEST_AC_STRING("abc", get_string(get_object_value(&v, 4)), get_string_length(get_object_value(&v, 4)));
+    TEST_AC_STRING("a", get_object_key(&v, 5), get_object_key_length(&v, 5));
+    TEST_AC_INT(ARRAY, get_value(get_object_value(&v, 5)));
+    EXPECT_AC_SIZE_T(3, get_array_size(get_object_value(&v, 5)));
+    for (i = 0; i < 3; i++) {
+        json_value* e = get_array_element(get_object_value(&v, 5), i);
+        TEST_AC_INT(NUMBER, get_value(e));
+        TEST_AC_DOUBLE(i + 1.0, get_number(e));
+    }
+    TEST_AC_STRING("o", get_object_key(&v, 6), get_object_key_length(&v, 6));
+    {
+        json_value* o = get_object_value(&v, 6);
+        TEST_AC_INT(OBJECT, get_value(o));
+        for (i = 0; i < 3; i++) {
+            json_value* ov = get_object_value(o, i);
+            TEST_AC_TRUE(((char)('1' + i) == get_object_key(o, i)[0]));
+            EXPECT_AC_SIZE_T(1, get_object_key_length(o, i));
+            TEST_AC_INT(NUMBER, get_value(ov));
+            TEST_AC_DOUBLE(i + 1.0, get_number(ov));
+        }
+    }
+    json_free(&v);
+}
+
+void test_parse_miss_key()
+{
+    TEST_ERROR(PARSE_MISS_KEY, "{:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{1:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{true:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{false:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{null:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{[]:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{{}:1,");
+    TEST_ERROR(PARSE_MISS_KEY, "{\"a\":1,");
+}
+
+void test_parse_miss_colon()
+{
+    TEST_ERROR(PARSE_MISS_COLON, "{\"a\"}");
+    TEST_ERROR(PARSE_MISS_COLON, "{\"a\",\"b\"}");
+}
+
+void test_parse_miss_comma_or_curly_bracket()
+{
+    TEST_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1");
+    TEST_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1]");
+    TEST_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1 \"b\"");
+    TEST_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
+}
+
 void test_access_null()
 {
     json_value v;
@@ -313,13 +478,831 @@ void test_access_string()
     json_free(&v);
 }
 
+void test_access_array()
+{
+    json_value a, e;
+    size_t i, j;
+
+    json_init(&a);
+    for (j = 0; j <= 5; j += 5) {
+        set_array(&a, j);
+        EXPECT_AC_SIZE_T(0, get_array_size(&a));
+        EXPECT_AC_SIZE_T(j, get_array_capacity(&a));
+        for (i = 0; i < 10; i++) {
+            set_number(pushback_array_element(&a), i);
+        }
+        EXPECT_AC_SIZE_T(10, get_array_size(&a));
+        for (i = 0; i < 10; i++)
+            TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+    }
+
+    popback_array_element(&a);
+    EXPECT_AC_SIZE_T(9, get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+
+    erase_array_element(&a, 4, 0);
+    EXPECT_AC_SIZE_T(9, get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+
+    erase_array_element(&a, 8, 1);
+    EXPECT_AC_SIZE_T(8, get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+
+    erase_array_element(&a, 0, 2);
+    EXPECT_AC_SIZE_T(6, get_array_size(&a));
+    for (i = 0; i < 6; i++)
+        TEST_AC_DOUBLE((double)i + 2, get_number(get_array_element(&a, i)));
+
+    for (i = 0; i < 2; i++) {
+        set_number(insert_array_element(&a, i), i);
+    }
+    EXPECT_AC_SIZE_T(8, get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+
+    TEST_AC_TRUE((get_array_capacity(&a) > 8));
+    shrink_array(&a);
+    EXPECT_AC_SIZE_T(8, get_array_capacity(&a));
+    EXPECT_AC_SIZE_T(8, get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        TEST_AC_DOUBLE((double)i, get_number(get_array_element(&a, i)));
+
+    json_init(&e);
+    set_string(&e, "Hello", 5);
+    memcpy(pushback_array_element(&a), &e, sizeof(json_value)); /* 移入，不拷贝 */
+    i = get_array_capacity(&a);
+    clear_array(&a);
+    EXPECT_AC_SIZE_T(0, get_array_size(&a));
+    EXPECT_AC_SIZE_T(i, get_array_capacity(&a));
+    shrink_array(&a);
+    EXPECT_AC_SIZE_T(0, get_array_capacity(&a));
+
+    json_free(&a);
+}
+
+void test_access_object()
+{
+    json_value o;
+    size_t i, j, index;
+
+    json_init(&o);
+    for (j = 0; j <= 5; j += 5) {
+        set_object(&o, j);
+        EXPECT_AC_SIZE_T(0, get_object_size(&o));
+        EXPECT_AC_SIZE_T(j, get_object_capacity(&o));
+        for (i = 0; i < 10; i++) {
+            char key[] = "a";
+            key[0] += i;
+            set_number(set_object_value(&o, key, 1), i);
+        }
+        EXPECT_AC_SIZE_T(10, get_object_size(&o));
+        for (i = 0; i < 10; i++) {
+            char key[] = "a";
+            key[0] += i;
+            index = find_object_index(&o, key, 1);
+            TEST_AC_TRUE((index != KEY_NOT_EXIST));
+            TEST_AC_STRING(key, get_object_key(&o, index), get_object_key_length(&o, index));
+            TEST_AC_DOUBLE((double)i, get_number(get_object_value(&o, index)));
+        }
+    }
+
+    index = find_object_index(&o, "j", 1);
+    TEST_AC_TRUE((index != KEY_NOT_EXIST));
+    remove_object_value(&o, index);
+    index = find_object_index(&o, "j", 1);
+    TEST_AC_TRUE((index == KEY_NOT_EXIST));
+    EXPECT_AC_SIZE_T(9, get_object_size(&o));
+
+    index = find_object_index(&o, "a", 1);
+    TEST_AC_TRUE((index != KEY_NOT_EXIST));
+    remove_object_value(&o, index);
+    TEST_AC_TRUE((find_object_value(&o, "a", 1) == NULL));
+    EXPECT_AC_SIZE_T(8, get_object_size(&o));
+
+    TEST_AC_TRUE((get_object_capacity(&o) > 8));
+    shrink_object(&o);
+    EXPECT_AC_SIZE_T(8, get_object_capacity(&o));
+    EXPECT_AC_SIZE_T(8, get_object_size(&o));
+    for (i = 0; i < 8; i++) {
+        char key[] = "a";
+        key[0] += i + 1;
+        TEST_AC_DOUBLE((double)i + 1, get_number(get_object_value(&o, find_object_index(&o, key, 1))));
+    }
+
+    set_string(set_object_value(&o, "name", 4), "Hello", 5);
+    TEST_AC_STRING("Hello", get_string(find_object_value(&o, "name", 4)), get_string_length(find_object_value(&o, "name", 4)));
+
+    i = get_object_capacity(&o);
+    clear_object(&o);
+    EXPECT_AC_SIZE_T(0, get_object_size(&o));
+    EXPECT_AC_SIZE_T(i, get_object_capacity(&o));
+    shrink_object(&o);
+    EXPECT_AC_SIZE_T(0, get_object_capacity(&o));
+
+    /* pushback_object_member 不查重，按追加顺序保留 */
+    set_number(pushback_object_member(&o, "k", 1), 1);
+    set_number(pushback_object_member(&o, "k", 1), 2);
+    EXPECT_AC_SIZE_T(2, get_object_size(&o));
+    TEST_AC_STRING("k", get_object_key(&o, 1), get_object_key_length(&o, 1));
+    TEST_AC_DOUBLE(1.0, get_number(find_object_value(&o, "k", 1)));
+    TEST_AC_DOUBLE(2.0, get_number(get_object_value(&o, 1)));
+
+    /* insert/erase/popback 按位置操作成员，同样不查重 */
+    set_number(insert_object_member(&o, 0, "x", 1), 0);
+    set_number(insert_object_member(&o, 2, "y", 1), 3);
+    set_string(insert_object_member(&o, 4, "k", 1), "z", 1);
+    EXPECT_AC_SIZE_T(5, get_object_size(&o));
+    TEST_AC_STRING("x", get_object_key(&o, 0), get_object_key_length(&o, 0));
+    TEST_AC_STRING("k", get_object_key(&o, 1), get_object_key_length(&o, 1));
+    TEST_AC_STRING("y", get_object_key(&o, 2), get_object_key_length(&o, 2));
+    TEST_AC_STRING("k", get_object_key(&o, 3), get_object_key_length(&o, 3));
+    TEST_AC_STRING("k", get_object_key(&o, 4), get_object_key_length(&o, 4));
+    TEST_AC_DOUBLE(3.0, get_number(get_object_value(&o, 2)));
+    TEST_AC_DOUBLE(2.0, get_number(get_object_value(&o, 3)));
+    erase_object_member(&o, 1, 2);
+    EXPECT_AC_SIZE_T(3, get_object_size(&o));
+    TEST_AC_STRING("x", get_object_key(&o, 0), get_object_key_length(&o, 0));
+    TEST_AC_DOUBLE(2.0, get_number(find_object_value(&o, "k", 1)));
+    erase_object_member(&o, 3, 0);
+    EXPECT_AC_SIZE_T(3, get_object_size(&o));
+    popback_object_member(&o);
+    EXPECT_AC_SIZE_T(2, get_object_size(&o));
+    TEST_AC_STRING("k", get_object_key(&o, 1), get_object_key_length(&o, 1));
+    TEST_AC_DOUBLE(2.0, get_number(get_object_value(&o, 1)));
+    erase_object_member(&o, 0, 2);
+    EXPECT_AC_SIZE_T(0, get_object_size(&o));
+
+    json_free(&o);
+}
+
+void test_copy()
+{
+    json_value v1, v2;
+    json_init(&v1);
+    TEST_AC_INT(PARSE_OK, parse(&v1, "[ null , false , true , 123 , \"abc\" , [ 1 , [ \"x\" ] ] ]"));
+    json_value* o = pushback_array_element(&v1);
+    set_object(o, 0);
+    set_string(set_object_value(o, "k", 1), "v", 1);
+    set_object(pushback_array_element(&v1), 0);
+    json_init(&v2);
+    json_copy(&v2, &v1);
+    EXPECT_AC_SIZE_T(get_array_size(&v1), get_array_size(&v2));
+    EXPECT_AC_SIZE_T(get_array_size(&v2), get_array_capacity(&v2));
+    TEST_AC_TRUE((get_array_element(&v1, 4)->s.s != get_array_element(&v2, 4)->s.s));
+    TEST_AC_STRING("abc", get_string(get_array_element(&v2, 4)), get_string_length(get_array_element(&v2, 4)));
+    json_value* inner = get_array_element(get_array_element(get_array_element(&v2, 5), 1), 0);
+    TEST_AC_STRING("x", get_string(inner), get_string_length(inner));
+    json_value* member = find_object_value(get_array_element(&v2, 6), "k", 1);
+    TEST_AC_TRUE((member != NULL));
+    TEST_AC_STRING("v", get_string(member), get_string_length(member));
+    EXPECT_AC_SIZE_T(0, get_object_size(get_array_element(&v2, 7)));
+    json_free(&v1);
+    TEST_AC_STRING("x", get_string(inner), get_string_length(inner));
+    json_free(&v2);
+}
+
+void test_move()
+{
+    json_value v1, v2, v3;
+    json_init(&v1);
+    TEST_AC_INT(PARSE_OK, parse(&v1, "[ \"abc\" , [ 1 ] ]"));
+    json_value* e = v1.a.e;
+    json_init(&v2);
+    json_move(&v2, &v1);
+    TEST_AC_INT(JSON_NULL, get_value(&v1));
+    TEST_AC_TRUE((v2.a.e == e));
+    json_init(&v3);
+    set_string(&v3, "old", 3);
+    json_move(&v3, &v2);
+    TEST_AC_INT(JSON_NULL, get_value(&v2));
+    EXPECT_AC_SIZE_T(2, get_array_size(&v3));
+    json_free(&v3);
+}
+
+void test_swap()
+{
+    json_value v1, v2;
+    json_init(&v1);
+    json_init(&v2);
+    set_string(&v1, "Hello", 5);
+    set_string(&v2, "World!", 6);
+    json_swap(&v1, &v2);
+    TEST_AC_STRING("World!", get_string(&v1), get_string_length(&v1));
+    TEST_AC_STRING("Hello", get_string(&v2), get_string_length(&v2));
+    json_swap(&v1, &v1);
+    TEST_AC_STRING("World!", get_string(&v1), get_string_length(&v1));
+    json_free(&v1);
+    json_free(&v2);
+}
+
+json::Document make_document(const char* json)
+{
+    json::Document d;
+    d.parse(json);
+    return d;
+}
+
+void test_document()
+{
+    json::Document d = make_document("[ \"abc\" , 1 ]");
+    TEST_AC_TRUE(d.ok());
+    TEST_AC_INT(ARRAY, d.type());
+    json_value* e = d.get()->a.e;
+
+    json::Document moved(std::move(d));
+    TEST_AC_INT(JSON_NULL, d.type());
+    TEST_AC_TRUE((moved.get()->a.e == e));
+
+    json::Value copy = moved.clone();
+    TEST_AC_TRUE((copy.get()->a.e != e));
+    EXPECT_AC_SIZE_T(2, get_array_size(copy.get()));
+
+    json::Value other;
+    set_number(other.get(), 1.0);
+    swap(copy, other);
+    TEST_AC_INT(NUMBER, copy.type());
+    TEST_AC_INT(ARRAY, other.type());
+
+    TEST_AC_INT(PARSE_INVALID_UTF8, moved.parse("\"\xFF\""));
+    TEST_AC_FALSE(moved.ok());
+    TEST_AC_INT(JSON_NULL, moved.type());
+
+    json_value raw;
+    json_init(&raw);
+    other.release(&raw);
+    TEST_AC_INT(JSON_NULL, other.type());
+    json::Value adopted = json::Value::adopt(&raw);
+    TEST_AC_INT(ARRAY, adopted.type());
+    TEST_AC_INT(JSON_NULL, get_value(&raw));
+
+    /* 移动不抛异常，容器扩容时只搬指针 */
+    static_assert(std::is_nothrow_move_constructible<json::Value>::value, "Value move must be noexcept");
+    static_assert(std::is_nothrow_move_assignable<json::Value>::value, "Value move must be noexcept");
+    static_assert(std::is_nothrow_move_constructible<json::Document>::value, "Document move must be noexcept");
+    static_assert(std::is_nothrow_move_assignable<json::Document>::value, "Document move must be noexcept");
+    std::vector<json::Document> docs;
+    docs.push_back(make_document("[1, 2, 3]"));
+    e = docs[0].get()->a.e;
+    for (int i = 0; i < 16; i++) {
+        docs.push_back(make_document("[]"));
+    }
+    TEST_AC_TRUE((docs[0].get()->a.e == e));
+}
+
+typedef struct {
+    size_t live_bytes;
+    size_t allocs;
+    size_t frees;
+}counting_pool;
+
+void* counting_malloc(void* user, size_t size)
+{
+    counting_pool* pool = (counting_pool*)user;
+    pool->live_bytes += size;
+    pool->allocs++;
+    return malloc(size);
+}
+
+void* counting_realloc(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+    counting_pool* pool = (counting_pool*)user;
+    pool->live_bytes += new_size - old_size;
+    pool->allocs++;
+    return realloc(ptr, new_size);
+}
+
+void counting_free(void* user, void* ptr, size_t size)
+{
+    counting_pool* pool = (counting_pool*)user;
+    pool->live_bytes -= size;
+    pool->frees++;
+    free(ptr);
+}
+
+void test_allocator()
+{
+    counting_pool pool = { 0, 0, 0 };
+    json_allocator alloc = { counting_malloc, counting_realloc, counting_free, &pool };
+    parse_stats stats;
+    parse_options opt = { PARSE_FLAG_DEFAULT, &alloc, &stats };
+    json_value v, copy;
+
+    json_init(&v);
+    TEST_AC_INT(PARSE_OK, parse_with_options(&v, "[ \"abc\" , [ [ 1 ] , \"\" ] , [ ] ]", &opt));
+    EXPECT_AC_SIZE_T(3, stats.max_depth);
+    TEST_AC_TRUE((stats.peak_stack_size > 0));
+    EXPECT_AC_SIZE_T(pool.allocs, stats.alloc_count);
+    TEST_AC_TRUE((pool.live_bytes > 0));
+    json_init(&copy);
+    json_copy_with(&copy, &v, &alloc);
+    json_free_with(&v, &alloc);
+    json_free_with(&copy, &alloc);
+    EXPECT_AC_SIZE_T(0, pool.live_bytes);
+    EXPECT_AC_SIZE_T(pool.allocs, pool.frees);
+
+    /* 出错时已分配的内存也要经过同一个分配器释放 */
+    TEST_AC_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, parse_with_options(&v, "[ \"abc\" , [ 1 ] ", &opt));
+    EXPECT_AC_SIZE_T(0, pool.live_bytes);
+    EXPECT_AC_SIZE_T(2, stats.max_depth);
+
+    TEST_AC_INT(PARSE_OK, parse_with_options(&v, "1", &opt));
+    EXPECT_AC_SIZE_T(0, stats.alloc_count);
+    EXPECT_AC_SIZE_T(0, stats.max_depth);
+
+    {
+        json::Document d(&alloc);
+        TEST_AC_INT(PARSE_OK, d.parse("[ \"abc\" , \"def\" ]", PARSE_FLAG_DEFAULT, &stats));
+        json::Value c = d.clone();
+        TEST_AC_TRUE((c.allocator() == &alloc));
+        TEST_AC_INT(PARSE_OK, d.parse("[ ]"));
+    }
+    EXPECT_AC_SIZE_T(0, pool.live_bytes);
+
+    /* 修改自定义分配器的树：每次分配和释放都经过同一个分配器，大小也对得上 */
+    {
+        json::Document d(&alloc);
+        TEST_AC_INT(PARSE_OK, d.parse("{ \"a\" : \"abc\" , \"b\" : [ 1 , \"x\" ] }"));
+        json_value* root = d.get();
+        json_value* a = find_object_value(root, "a", 1);
+        json_value* b = find_object_value(root, "b", 1);
+        set_string_with(a, "Hello World", 11, d.allocator());
+        set_array_with(pushback_array_element_with(b, d.allocator()), 0, d.allocator());
+        set_string_with(insert_array_element_with(b, 0, d.allocator()), "y", 1, d.allocator());
+        reserve_array_with(b, 16, d.allocator());
+        shrink_array_with(b, d.allocator());
+        erase_array_element_with(b, 1, 1, d.allocator());
+        popback_array_element_with(b, d.allocator());
+        set_object_with(pushback_object_member_with(root, "c", 1, d.allocator()), 4, d.allocator());
+        set_number_with(set_object_value_with(root, "b", 1, d.allocator()), 2.0, d.allocator());
+        set_boolean_with(set_object_value_with(root, "d", 1, d.allocator()), 1, d.allocator());
+        reserve_object_with(root, 32, d.allocator());
+        remove_object_value_with(root, 0, d.allocator());
+        shrink_object_with(root, d.allocator());
+        set_string_with(insert_object_member_with(root, 1, "long key", 8, d.allocator()), "Hello World", 11, d.allocator());
+        set_string_with(insert_object_member_with(root, 4, "e", 1, d.allocator()), "abc", 3, d.allocator());
+        erase_object_member_with(root, 1, 1, d.allocator());
+        popback_object_member_with(root, d.allocator());
+        EXPECT_AC_SIZE_T(3, get_object_size(root));
+        TEST_AC_DOUBLE(2.0, get_number(find_object_value(root, "b", 1)));
+
+        json_value raw;
+        json_init(&raw);
+        d.release(&raw);
+        json::Value owner = json::Value::adopt(&raw, &alloc);
+        clear_object_with(owner.get(), owner.allocator());
+        TEST_AC_TRUE((pool.live_bytes > 0));
+    }
+    EXPECT_AC_SIZE_T(0, pool.live_bytes);
+}
+
+void test_bind()
+{
+    bind_record r;
+    r.id = 0;
+    r.active = false;
+    r.flags = 7;
+    TEST_AC_INT(PARSE_OK, json::decode(r,
+        " { \"id\" : 42 , \"name\" : \"Hello\\nWorld\" , \"unknown\" : { \"a\" : [ 1 , \"x\" , null , true ] } ,"
+        " \"active\" : true , \"path\" : [ { \"x\" : 1.5 , \"y\" : -2 } , { \"y\" : 3 , \"x\" : 4 , \"z\" : 5 } ] ,"
+        " \"tags\" : [ \"a\" , \"\\u20AC\" ] , \"flags\" : 1 , \"flag_bits\" : null } "));
+    TEST_AC_INT(42, r.id);
+    TEST_AC_STRING("Hello\nWorld", r.name.data(), r.name.size());
+    TEST_AC_TRUE(r.active);
+    EXPECT_AC_SIZE_T(2, r.path.size());
+    TEST_AC_DOUBLE(1.5, r.path[0].x);
+    TEST_AC_DOUBLE(-2.0, r.path[0].y);
+    TEST_AC_DOUBLE(4.0, r.path[1].x);
+    TEST_AC_DOUBLE(3.0, r.path[1].y);
+    EXPECT_AC_SIZE_T(2, r.tags.size());
+    TEST_AC_STRING("a", r.tags[0].data(), r.tags[0].size());
+    TEST_AC_STRING("\xE2\x82\xAC", r.tags[1].data(), r.tags[1].size());
+    TEST_AC_INT(7, (int)r.flags);
+
+    std::vector<int> a;
+    TEST_AC_INT(PARSE_OK, json::decode(a, "[ ]"));
+    EXPECT_AC_SIZE_T(0, a.size());
+    TEST_AC_INT(PARSE_OK, json::decode(a, "[1,2,3]"));
+    EXPECT_AC_SIZE_T(3, a.size());
+
+    bind_point p;
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(p, "{ \"x\" : \"1\" }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(p, "[ 1 ]"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(a, "[ 1 , false ]"));
+    TEST_AC_INT(PARSE_INVALID_VALUE, json::decode(p, "{ \"x\" : nul }"));
+    TEST_AC_INT(PARSE_INVALID_VALUE, json::decode(p, "{ \"z\" : [ 1 , ] }"));
+    TEST_AC_INT(PARSE_INVALID_UTF8, json::decode(r, "{ \"name\" : \"\xFF\" }"));
+    TEST_AC_INT(PARSE_MISS_KEY, json::decode(p, "{ 1 : 1 }"));
+    TEST_AC_INT(PARSE_MISS_COLON, json::decode(p, "{ \"x\" 1 }"));
+    TEST_AC_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, json::decode(p, "{ \"x\" : 1 "));
+    TEST_AC_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, json::decode(a, "[ 1 2 ]"));
+    TEST_AC_INT(PARSE_ROOT_NOT_SINGULAR, json::decode(a, "[ 1 ] 2"));
+    TEST_AC_INT(PARSE_EXPCET_VALUE, json::decode(p, " "));
+
+    /* 整数字段：超出范围或带小数都算类型不符，不做截断 */
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : 1e20 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : 1.9 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : 2147483648 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : -2147483649 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"flag_bits\" : -1 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"flag_bits\" : 4294967296 }"));
+    TEST_AC_INT(PARSE_OK, json::decode(r, "{ \"id\" : -2147483648 , \"flag_bits\" : 4294967295 }"));
+    TEST_AC_INT(-2147483647 - 1, r.id);
+    TEST_AC_TRUE((r.flags == 4294967295u));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : 3.0 }"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(r, "{ \"id\" : 3e0 }"));
+    TEST_AC_INT(PARSE_INVALID_VALUE, json::decode(r, "{ \"id\" : 3. }"));
+    TEST_AC_INT(PARSE_OK, json::decode(r, "{ \"id\" : -0 , \"flag_bits\" : -0 }"));
+    TEST_AC_INT(0, r.id);
+    TEST_AC_INT(0, (int)r.flags);
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(a, "[ 1 , 0.5 ]"));
+
+    unsigned char byte = 0;
+    TEST_AC_INT(PARSE_OK, json::decode(byte, "255"));
+    TEST_AC_INT(255, (int)byte);
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(byte, "256"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(byte, "-0.5"));
+
+    /* 64位整数不经过 double，2^53 以上也精确 */
+    long long wide = 0;
+    TEST_AC_INT(PARSE_OK, json::decode(wide, "-9223372036854775808"));
+    TEST_AC_TRUE((wide == std::numeric_limits<long long>::min()));
+    TEST_AC_INT(PARSE_OK, json::decode(wide, "-9223372036854775807"));
+    TEST_AC_TRUE((wide == std::numeric_limits<long long>::min() + 1));
+    TEST_AC_INT(PARSE_OK, json::decode(wide, "9007199254740993"));
+    TEST_AC_TRUE((wide == 9007199254740993LL));
+    TEST_AC_INT(PARSE_OK, json::decode(wide, "9223372036854775806"));
+    TEST_AC_TRUE((wide == std::numeric_limits<long long>::max() - 1));
+    TEST_AC_INT(PARSE_OK, json::decode(wide, "9223372036854775807"));
+    TEST_AC_TRUE((wide == std::numeric_limits<long long>::max()));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(wide, "9223372036854775808"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(wide, "-9223372036854775809"));
+
+    unsigned long long uwide = 0;
+    TEST_AC_INT(PARSE_OK, json::decode(uwide, "18446744073709551615"));
+    TEST_AC_TRUE((uwide == std::numeric_limits<unsigned long long>::max()));
+    TEST_AC_INT(PARSE_OK, json::decode(uwide, "9007199254740993"));
+    TEST_AC_TRUE((uwide == 9007199254740993ULL));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(uwide, "18446744073709551616"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(uwide, "-1"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(uwide, "1e3"));
+
+    /* 浮点字段只检查溢出 */
+    float f = 0;
+    TEST_AC_INT(PARSE_OK, json::decode(f, "1.9"));
+    TEST_AC_TRUE((f == 1.9f));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(f, "1e39"));
+    TEST_AC_INT(PARSE_TYPE_MISMATCH, json::decode(f, "-1e39"));
+    double d = 0;
+    TEST_AC_INT(PARSE_OK, json::decode(d, "1e300"));
+    TEST_AC_DOUBLE(1e300, d);
+}
+
+#define TEST_EQUAL(json1, json2, equality)                  \
+    do                                                      \
+    {                                                       \
+        json_value v1, v2;                                  \
+        json_init(&v1);                                     \
+        json_init(&v2);                                     \
+        TEST_AC_INT(PARSE_OK, parse(&v1, json1));           \
+        TEST_AC_INT(PARSE_OK, parse(&v2, json2));           \
+        TEST_AC_INT(equality, json_equal(&v1, &v2));        \
+        TEST_AC_INT(equality, json_equal(&v2, &v1));        \
+        if (equality)                                       \
+            EXPECT_AC_SIZE_T(json_hash(&v1), json_hash(&v2)); \
+        json_free(&v1);                                     \
+        json_free(&v2);                                     \
+    } while (0)
+
+void test_equal()
+{
+    TEST_EQUAL("true", "true", 1);
+    TEST_EQUAL("true", "false", 0);
+    TEST_EQUAL("false", "false", 1);
+    TEST_EQUAL("null", "null", 1);
+    TEST_EQUAL("null", "0", 0);
+    TEST_EQUAL("123", "123", 1);
+    TEST_EQUAL("123", "456", 0);
+    TEST_EQUAL("0", "-0", 1);
+    TEST_EQUAL("1.5", "15e-1", 1);
+    TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+    TEST_EQUAL("\"abc\"", "\"abd\"", 0);
+    TEST_EQUAL("\"abc\"", "\"ab\"", 0);
+    TEST_EQUAL("\"a\\u0000b\"", "\"a\\u0000c\"", 0);
+    TEST_EQUAL("[]", "[]", 1);
+    TEST_EQUAL("[]", "null", 0);
+    TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+    TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+    TEST_EQUAL("[1,2,3]", "[3,2,1]", 0);
+    TEST_EQUAL("[[]]", "[[]]", 1);
+    TEST_EQUAL("{}", "{}", 1);
+    TEST_EQUAL("{}", "null", 0);
+    TEST_EQUAL("{}", "[]", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":2}", 0);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+    TEST_EQUAL("{\"x\":[1,{\"y\":true,\"z\":null}]}", "{\"x\":[1,{\"z\":null,\"y\":true}]}", 1);
+    /* 重复键：成员一一对应，两个方向结果相同 */
+    TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"b\":2}", 0);
+    TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"a\":2}", "{\"a\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"a\":2}", "{\"a\":1,\"a\":1}", 0);
+    TEST_EQUAL("{\"b\":0,\"a\":1,\"a\":1,\"a\":2}", "{\"a\":2,\"a\":1,\"b\":0,\"a\":1}", 1);
+    TEST_EQUAL("{\"b\":0,\"a\":1,\"a\":1,\"c\":2}", "{\"a\":1,\"c\":2,\"b\":0,\"a\":2}", 0);
+
+    /* 超过栈上缓冲的大对象：逆序排列、含重复键 */
+    json_value v1, v2;
+    char key[16];
+    const int n = 1000;
+    json_init(&v1);
+    json_init(&v2);
+    set_object(&v1, n);
+    set_object(&v2, n);
+    for (int i = 0; i < n; i++) {
+        int klen = snprintf(key, sizeof(key), "k%d", i % 700);
+        set_number(pushback_object_member(&v1, key, klen), i);
+        klen = snprintf(key, sizeof(key), "k%d", (n - 1 - i) % 700);
+        set_number(pushback_object_member(&v2, key, klen), n - 1 - i);
+    }
+    TEST_AC_INT(1, json_equal(&v1, &v2));
+    TEST_AC_INT(1, json_equal(&v2, &v1));
+    EXPECT_AC_SIZE_T(json_hash(&v1), json_hash(&v2));
+    /* 只改两个成员的值，键的多重集合不变 */
+    set_number(get_object_value(&v2, 0), 0);
+    set_number(get_object_value(&v2, n - 1), n - 1);
+    TEST_AC_INT(0, json_equal(&v1, &v2));
+    TEST_AC_INT(0, json_equal(&v2, &v1));
+    json_free(&v1);
+    json_free(&v2);
+}
+
+void test_hash()
+{
+    json::Document a, b, c;
+    a.parse("{\"a\":1,\"b\":[\"x\",\"y\"]}");
+    b.parse("{\"b\":[\"x\",\"y\"],\"a\":1}");
+    c.parse("{\"a\":1,\"b\":[\"y\",\"x\"]}");
+    TEST_AC_TRUE((a == b));
+    TEST_AC_TRUE((a != c));
+    EXPECT_AC_SIZE_T(json::Hash()(a), json::Hash()(b));
+    TEST_AC_TRUE((json::Hash()(a) != json::Hash()(c)));
+
+    std::unordered_map<json::Value, int> cache;
+    cache.emplace(std::move(a), 1);
+    cache.emplace(std::move(c), 2);
+    TEST_AC_INT(1, cache.find(b)->second);
+    EXPECT_AC_SIZE_T(2, cache.size());
+
+    std::unordered_map<const json_value*, int, json::Hash, json::Equal> by_ptr;
+    json::Document d;
+    d.parse("[1,\"two\",{\"three\":3}]");
+    by_ptr[d.get()] = 3;
+    json::Value e = d.clone();
+    TEST_AC_INT(3, by_ptr[e.get()]);
+}
+
+#define TEST_REFORMAT(expect, json, indent)                                  \
+    do                                                                      \
+    {                                                                       \
+        char* out;                                                          \
+        size_t length;                                                      \
+        TEST_AC_INT(PARSE_OK, json_reformat_string(json, indent, &out, &length)); \
+        TEST_AC_STRING(expect, out, length);                                \
+        free(out);                                                          \
+    } while (0)
+
+#define TEST_REFORMAT_ERROR(error, json)                                    \
+    do                                                                      \
+    {                                                                       \
+        char* out;                                                          \
+        TEST_AC_INT(error, json_reformat_string(json, 0, &out, NULL));      \
+        TEST_AC_TRUE((out == NULL));                                        \
+    } while (0)
+
+void test_reformat()
+{
+    TEST_REFORMAT("null", " null ", 0);
+    TEST_REFORMAT("-1.50E+10", "-1.50E+10", 0);   /* 数字原样输出 */
+    TEST_REFORMAT("\"a\\u00A2\\n\xE2\x82\xAC\"", " \"a\\u00A2\\n\xE2\x82\xAC\" ", 0);
+    TEST_REFORMAT("[]", "[ ]", 0);
+    TEST_REFORMAT("{}", " { } ", 4);
+    TEST_REFORMAT("[1,true,false,null,\"x\",[],{}]", " [ 1 , true , false , null , \"x\" , [ ] , { } ] ", 0);
+    TEST_REFORMAT("{\"a\":[1,{\"b\":\"c\"}],\"d\":{}}", "{ \"a\" :\n [ 1 ,\t{ \"b\" : \"c\" } ] , \"d\" : { } }", 0);
+    TEST_REFORMAT(
+        "{\n"
+        "  \"a\": [\n"
+        "    1,\n"
+        "    {\n"
+        "      \"b\": \"c\"\n"
+        "    }\n"
+        "  ],\n"
+        "  \"d\": {}\n"
+        "}",
+        "{\"a\":[1,{\"b\":\"c\"}],\"d\":{}}", 2);
+
+    TEST_REFORMAT_ERROR(PARSE_EXPCET_VALUE, " ");
+    TEST_REFORMAT_ERROR(PARSE_INVALID_VALUE, "[1,]");
+    TEST_REFORMAT_ERROR(PARSE_ROOT_NOT_SINGULAR, "[1] 2");
+    TEST_REFORMAT_ERROR(PARSE_NUMBER_TOO_BIG, "[1e309]");
+    TEST_REFORMAT_ERROR(PARSE_INVALID_STRING_ESCAPE, "[\"\\v\"]");
+    TEST_REFORMAT_ERROR(PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\"");
+    TEST_REFORMAT_ERROR(PARSE_INVALID_UTF8, "\"\xC0\xAF\"");
+    TEST_REFORMAT_ERROR(PARSE_MISS_QUOTATION_MARK, "[\"abc");
+    TEST_REFORMAT_ERROR(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]");
+    TEST_REFORMAT_ERROR(PARSE_MISS_KEY, "{1:1}");
+    TEST_REFORMAT_ERROR(PARSE_MISS_COLON, "{\"a\" 1}");
+    TEST_REFORMAT_ERROR(PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1");
+}
+
+typedef struct {
+    size_t chunks;
+    size_t bytes;
+    size_t max_chunk;
+}sink_counter;
+
+void count_sink(void* user, const char* data, size_t len)
+{
+    sink_counter* s = (sink_counter*)user;
+    (void)data;
+    s->chunks++;
+    s->bytes += len;
+    if (len > s->max_chunk) {
+        s->max_chunk = len;
+    }
+}
+
+void test_reformat_sink()
+{
+    std::string json = "[";
+    for (int i = 0; i < 10000; i++) {
+        json += i ? " , " : "";
+        json += "{ \"k\" : [ 1 , 2 ] }";
+    }
+    json += " ]";
+    sink_counter s = { 0, 0, 0 };
+    TEST_AC_INT(PARSE_OK, json_reformat(json.c_str(), 0, count_sink, &s));
+    EXPECT_AC_SIZE_T(2 + 10000 * 12 - 1, s.bytes);
+    TEST_AC_TRUE((s.chunks > 1));
+    TEST_AC_TRUE((s.max_chunk <= 4096));
+
+    /* 重排后的结果解析出的树与原输入相同 */
+    char* pretty;
+    json_value v1, v2;
+    TEST_AC_INT(PARSE_OK, json_reformat_string(json.c_str(), 4, &pretty, NULL));
+    json_init(&v1);
+    json_init(&v2);
+    TEST_AC_INT(PARSE_OK, parse(&v1, json.c_str()));
+    TEST_AC_INT(PARSE_OK, parse(&v2, pretty));
+    TEST_AC_TRUE(json_equal(&v1, &v2));
+    json_free(&v1);
+    json_free(&v2);
+    free(pretty);
+}
+
+#define TEST_REPARSE(old_json, new_json)                     \
+    do                                                      \
+    {                                                       \
+        json_value v1, v2;                                  \
+        json_init(&v1);                                     \
+        json_init(&v2);                                     \
+        TEST_AC_INT(PARSE_OK, parse(&v1, old_json));        \
+        TEST_AC_INT(PARSE_OK, reparse(&v1, new_json));      \
+        TEST_AC_INT(PARSE_OK, parse(&v2, new_json));        \
+        TEST_AC_TRUE(json_equal(&v1, &v2));                 \
+        json_free(&v1);                                     \
+        json_free(&v2);                                     \
+    } while (0)
+
+void test_reparse()
+{
+    TEST_REPARSE("null", "[1,\"a\",{\"b\":true}]");
+    TEST_REPARSE("[1,\"a\",{\"b\":true}]", "null");
+    TEST_REPARSE("\"short\"", "\"a much longer string\"");
+    TEST_REPARSE("\"a much longer string\"", "\"short\"");
+    TEST_REPARSE("\"abc\"", "\"a\\u00A2\\n\"");
+    TEST_REPARSE("[1,2,3,4,5]", "[1,2]");
+    TEST_REPARSE("[1,2]", "[1,2,3,4,5]");
+    TEST_REPARSE("[1,2]", "[]");
+    TEST_REPARSE("[\"a\",[1]]", "[[1],\"a\"]");
+    TEST_REPARSE("{\"a\":1,\"b\":2,\"c\":3}", "{\"a\":\"x\"}");
+    TEST_REPARSE("{\"a\":1}", "{\"a\":1,\"b\":[2],\"c\":{\"d\":3}}");
+    TEST_REPARSE("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}");
+    TEST_REPARSE("{\"a\":1}", "{\"\\u0061\":1}");
+    TEST_REPARSE("{\"a\":1}", "{}");
+    TEST_REPARSE("{\"a\":[1,2]}", "[{\"a\":[1,2]}]");
+
+    json_value v;
+    parse_stats stats;
+    parse_options opt = { PARSE_FLAG_DEFAULT, NULL, &stats };
+    json_init(&v);
+    TEST_AC_INT(PARSE_OK, reparse_with_options(&v, "{\"id\":1,\"name\":\"alice\",\"tags\":[\"x\",\"y\"],\"pos\":{\"x\":1,\"y\":2}}", &opt));
+    TEST_AC_TRUE((stats.alloc_count > 0));
+    const char* name = get_string(find_object_value(&v, "name", 4));
+    json_value* tags = get_object_value(&v, 2);
+    json_value* tag_elements = tags->a.e;
+
+    /* 结构相同的消息不再分配，原有缓冲区被复用 */
+    TEST_AC_INT(PARSE_OK, reparse_with_options(&v, "{\"id\":2,\"name\":\"bob\",\"tags\":[\"z\"],\"pos\":{\"x\":3,\"y\":4}}", &opt));
+    EXPECT_AC_SIZE_T(0, stats.alloc_count);
+    EXPECT_AC_SIZE_T(2, stats.max_depth);
+    TEST_AC_TRUE((get_string(find_object_value(&v, "name", 4)) == name));
+    TEST_AC_STRING("bob", get_string(find_object_value(&v, "name", 4)), get_string_length(find_object_value(&v, "name", 4)));
+    TEST_AC_TRUE((tags->a.e == tag_elements));
+    EXPECT_AC_SIZE_T(1, get_array_size(tags));
+    TEST_AC_DOUBLE(4.0, get_number(find_object_value(get_object_value(&v, 3), "y", 1)));
+
+    /* 变长的部分才需要分配 */
+    TEST_AC_INT(PARSE_OK, reparse_with_options(&v, "{\"id\":3,\"name\":\"carol-with-a-long-name\",\"tags\":[\"a\",\"b\"],\"pos\":{\"x\":5,\"y\":6}}", &opt));
+    EXPECT_AC_SIZE_T(2, stats.alloc_count);
+
+    TEST_AC_INT(PARSE_MISS_COMMA_OR_CURLY_BRACKET, reparse(&v, "{\"id\":4,\"name\":\"dave\""));
+    TEST_AC_INT(JSON_NULL, get_value(&v));
+    TEST_AC_INT(PARSE_ROOT_NOT_SINGULAR, reparse(&v, "[1] 2"));
+    TEST_AC_INT(JSON_NULL, get_value(&v));
+    TEST_AC_INT(PARSE_OK, reparse(&v, "[\"a\", {\"b\": 1}]"));
+    TEST_AC_INT(PARSE_INVALID_UTF8, reparse(&v, "[\"a\", {\"b\": \"\xFF\"}]"));
+    TEST_AC_INT(JSON_NULL, get_value(&v));
+    json_free(&v);
+
+    json::Document d;
+    TEST_AC_INT(PARSE_OK, d.reparse("[\"abc\", 1]"));
+    TEST_AC_INT(PARSE_OK, d.reparse("[\"def\", 2]", PARSE_FLAG_DEFAULT, &stats));
+    EXPECT_AC_SIZE_T(0, stats.alloc_count);
+    TEST_AC_INT(PARSE_EXPCET_VALUE, d.reparse(""));
+    TEST_AC_FALSE(d.ok());
+}
+
+#ifdef JSON_PROFILE
+void test_profile()
+{
+    const char* json = " [ \"a\\n\\u00e9\\uD834\\uDD1E\" , 12.5 , true , null ] ";
+    const json_profile* p = json_profile_get();
+    json_value v;
+    json_init(&v);
+    json_profile_reset();
+    TEST_AC_INT(PARSE_OK, parse(&v, json));
+    EXPECT_AC_SIZE_T(strlen(json), p->input_bytes);
+    EXPECT_AC_SIZE_T(10, p->whitespace_bytes);
+    EXPECT_AC_SIZE_T(23, p->string_bytes);
+    EXPECT_AC_SIZE_T(4, p->number_bytes);
+    EXPECT_AC_SIZE_T(8, p->literal_bytes);
+    EXPECT_AC_SIZE_T(3, p->escapes);
+    EXPECT_AC_SIZE_T(2, p->unicode_escapes);
+    EXPECT_AC_SIZE_T(1, p->surrogate_pairs);
+    TEST_AC_TRUE((p->stack_reallocs > 0));
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_STRING]);
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_NUMBER]);
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_STRTOD]);
+    EXPECT_AC_SIZE_T(0, p->calls[PROFILE_FREE]);
+    json_free(&v);
+    /* 递归释放只记一次 */
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_FREE]);
+
+    /* 解析出错、reparse 复用和 set_* 内部的释放都不算 json_free */
+    json_profile_reset();
+    TEST_AC_INT(PARSE_MISS_COMMA_OR_SQUARE_BRACKET, parse(&v, "[ \"a\" , [ 1 ] "));
+    TEST_AC_INT(PARSE_OK, parse(&v, "[ 1 , \"b\" , true ]"));
+    TEST_AC_INT(PARSE_OK, reparse(&v, "[ \"c\" , 2 , null ]"));
+    set_number(get_array_element(&v, 0), 1.0);
+    set_string(&v, "x", 1);
+    EXPECT_AC_SIZE_T(0, p->calls[PROFILE_FREE]);
+    json_free(&v);
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_FREE]);
+
+    /* reparse 遇到转义退回完整解码，一个字符串（含键）仍只记一次 */
+    TEST_AC_INT(PARSE_OK, parse(&v, "[ \"x\" ]"));
+    json_profile_reset();
+    TEST_AC_INT(PARSE_OK, reparse(&v, "[ \"a\\n\" ]"));
+    EXPECT_AC_SIZE_T(1, p->calls[PROFILE_STRING]);
+    EXPECT_AC_SIZE_T(5, p->string_bytes);
+    EXPECT_AC_SIZE_T(1, p->escapes);
+    TEST_AC_STRING("a\n", get_string(get_array_element(&v, 0)), get_string_length(get_array_element(&v, 0)));
+    json_profile_reset();
+    TEST_AC_INT(PARSE_OK, reparse(&v, "{ \"k\\t\" : \"b\" }"));
+    EXPECT_AC_SIZE_T(2, p->calls[PROFILE_STRING]);
+    json_free(&v);
+
+    json_profile_reset();
+    EXPECT_AC_SIZE_T(0, p->input_bytes);
+    EXPECT_AC_SIZE_T(0, p->calls[PROFILE_WHITESPACE]);
+}
+#endif
+
 void test_parse()
 {
     test_parse_null();
     test_parse_true();
     test_parse_false();
     test_parse_number();
+    parse_string();
     test_parse_array();
+    test_parse_object();
     test_parse_expect_value();
     test_parse_invalid_value();
     test_parse_root_not_singular();
@@ -330,11 +1313,33 @@ void test_parse()
     test_parse_invalid_unicode_hex();
     test_parse_invalid_unicode_surrogate();
     test_parse_miss_comma_or_square_bracket();
+    test_parse_invalid_utf8();
+    test_parse_no_utf8_validation();
+    test_parse_miss_key();
+    test_parse_miss_colon();
+    test_parse_miss_comma_or_curly_bracket();
     
     test_access_string();
     test_access_boolean();
     test_access_null();
     test_access_number();
+    test_access_array();
+    test_access_object();
+
+    test_copy();
+    test_move();
+    test_swap();
+    test_document();
+    test_allocator();
+    test_bind();
+    test_equal();
+    test_hash();
+    test_reformat();
+    test_reformat_sink();
+    test_reparse();
+#ifdef JSON_PROFILE
+    test_profile();
+#endif
 }
 
 int main()